@@ -1,7 +1,8 @@
 from __future__ import print_function  # In python 2.7
 
-from flask import Flask, render_template, current_app, request, jsonify, redirect
+from flask import Flask, render_template, current_app, request, jsonify, redirect, Response
 from flask_paginate import Pagination, get_page_args
+from werkzeug.middleware.proxy_fix import ProxyFix
 
 import sys
 import re
@@ -15,6 +16,8 @@ from pyparsing import ParseException
 
 app = Flask(__name__)
 app.config.from_pyfile('app.cfg')
+# http_server proxies this app under /objstore; honour its X-Forwarded-* headers so url_for() keeps the prefix
+app.wsgi_app = ProxyFix(app.wsgi_app, x_for=1, x_host=1, x_prefix=1)
 
 
 mc = MongoWrapper()
@@ -79,6 +82,17 @@ def serve_static_file():
     return jsonify(config)
 
 
+@app.route('/scene_frame/<int:ts>', methods=['GET'])
+def scene_frame(ts):
+    # raw frame for the /thumb/ resource of http_server, which scales and caches the thumbnails
+    frame = mc.get_scene_frame(ts)
+    if frame is None:
+        return Response(status=404)
+    width, height, data = frame
+    return Response(data, mimetype='application/octet-stream',
+                    headers={'X-Frame-Width': str(width), 'X-Frame-Height': str(height)})
+
+
 def handle_objects():
     objects = mc.get_all_persistent_objects()
     print("handle_objects.", file=sys.stderr)
@@ -105,7 +119,7 @@ def handle_scenes(ts1 = None, ts2 = None):
         # idx_end = 19
 
     for ts in timestamps[idx_begin:idx_end]:  # [idxB:idxE]:
-        scene = {'ts': ts, 'rgb': mc.get_scene_image(ts), 'objects': mc.get_object_hypotheses_for_scene(ts)}
+        scene = {'ts': ts, 'objects': mc.get_object_hypotheses_for_scene(ts)}
         scenes.append(scene)
     print("getting data took: %s seconds ---" % (time.time() - start_time), file=sys.stderr)
     # pagination = get_pagination(page=page,
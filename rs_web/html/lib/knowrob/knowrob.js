@@ -169,13 +169,12 @@ function Knowrob(options){
         fixedFrame : '/my_frame'
       });
         
-      var pointCloud = new ROS3D.PointCloud2({
-        ros : ros,
-        topic : '/RoboSherlock/points',
+      // Point clouds of /RoboSherlock/points, streamed by http_server as binary frames
+      var pointCloud = new ROS3D.CloudStream({
+        topic : 'points',
         tfClient : tfClient,
         rootObject : rosViewer.scene,
-        size: 0.02,
-        max_pts: 50000
+        size: 0.02
       });
         
       // Setup the marker client.
@@ -0,0 +1,164 @@
+/**
+ * Displays the point clouds that http_server streams on GET /clouds/<topic>, as quantized binary
+ * frames (see include/rs_web/pointcloud_http.hpp), instead of the rosbridge JSON of ROS3D.PointCloud2.
+ * When the stream ends, it is requested again.
+ *
+ * @constructor
+ * @param options - object with following keys:
+ *
+ *  * tfClient - the TF client handle to use
+ *  * topic (optional) - the cloud topic of the server (default 'points')
+ *  * lod (optional) - level of detail, 0 for every point, higher levels for fewer points (default 0)
+ *  * rootObject (optional) - the root object to add the points to
+ *  * size (optional) - size to draw each point (default 0.02)
+ *  * retry (optional) - milliseconds to wait before requesting the stream again (default 3000)
+ */
+ROS3D.CloudStream = function(options) {
+  options = options || {};
+  this.tfClient = options.tfClient;
+  this.url = '/clouds/' + (options.topic || 'points') + '?lod=' + (options.lod || 0);
+  this.rootObject = options.rootObject || new THREE.Object3D();
+  this.retry = options.retry || 3000;
+  this.sceneNode = null;
+  THREE.Object3D.call(this);
+
+  // the buffers are replaced by every frame
+  this.geometry = new THREE.BufferGeometry();
+  this.geometry.attributes = {
+    position : { itemSize : 3, array : new Float32Array(0), numItems : 0 },
+    color : { itemSize : 3, array : new Float32Array(0), numItems : 0 }
+  };
+  this.particles = new THREE.ParticleSystem(this.geometry, new THREE.ParticleBasicMaterial({
+    size : options.size || 0.02,
+    vertexColors : true
+  }));
+
+  this.connect();
+};
+ROS3D.CloudStream.prototype.__proto__ = THREE.Object3D.prototype;
+
+/**
+ * Requests the stream, and reads the frames as they arrive.
+ */
+ROS3D.CloudStream.prototype.connect = function() {
+  var that = this;
+  var reconnect = function() {
+    window.setTimeout(function() { that.connect(); }, that.retry);
+  };
+
+  fetch(this.url, { cache : 'no-store' }).then(function(response) {
+    if(response.status !== 200 || !response.body) {
+      return;
+    }
+    var reader = response.body.getReader();
+    var received = new Uint8Array(0);
+    var read = function() {
+      return reader.read().then(function(result) {
+        if(result.done) {
+          return;
+        }
+        if(received.length === 0) {
+          received = result.value;
+        } else {
+          var joined = new Uint8Array(received.length + result.value.length);
+          joined.set(received);
+          joined.set(result.value, received.length);
+          received = joined;
+        }
+        received = that.receive(received);
+        return read();
+      });
+    };
+    return read();
+  }).then(reconnect, reconnect);
+};
+
+/**
+ * Shows the last complete frame in data, and returns the rest of data.
+ *
+ * @param data - Uint8Array with the frames received so far
+ */
+ROS3D.CloudStream.prototype.receive = function(data) {
+  var frame = null;
+  while(data.length >= 4) {
+    var size = new DataView(data.buffer, data.byteOffset, 4).getUint32(0, true);
+    if(data.length < size) {
+      break;
+    }
+    frame = data.subarray(0, size);
+    data = data.subarray(size);
+  }
+  if(frame !== null) {
+    // the positions are read through a Uint16Array, which must be aligned
+    if(frame.byteOffset % 4 !== 0) {
+      frame = new Uint8Array(frame);
+    }
+    this.show(frame);
+  }
+  return data;
+};
+
+/**
+ * Replaces the points drawn with those of frame.
+ *
+ * @param frame - Uint8Array with one frame
+ */
+ROS3D.CloudStream.prototype.show = function(frame) {
+  var view = new DataView(frame.buffer, frame.byteOffset, frame.byteLength);
+  if(String.fromCharCode(frame[4], frame[5], frame[6], frame[7]) !== 'RSPC' || view.getUint32(8, true) !== 1) {
+    return;
+  }
+  var padded = function(size) { return (size + 3) & ~3; };
+  var n = view.getUint32(20, true);
+  var hasColors = (view.getUint32(24, true) & 1) !== 0;
+  var origin = [], scale = [];
+  for(var c = 0; c < 3; c++) {
+    origin[c] = view.getFloat32(28 + 4 * c, true);
+    scale[c] = view.getFloat32(40 + 4 * c, true);
+  }
+  var frameIDLength = view.getUint32(52, true);
+  var frameID = String.fromCharCode.apply(null, frame.subarray(56, 56 + frameIDLength));
+  var offset = 56 + padded(frameIDLength);
+  // typed arrays are in the byte order of the machine, which is little-endian on the platforms browsers run on
+  var quantized = new Uint16Array(frame.buffer, frame.byteOffset + offset, 3 * n);
+  offset += padded(6 * n);
+
+  var positions = new Float32Array(3 * n);
+  var colors = new Float32Array(3 * n);
+  for(var i = 0; i < 3 * n; i += 3) {
+    positions[i] = origin[0] + quantized[i] * scale[0];
+    positions[i + 1] = origin[1] + quantized[i + 1] * scale[1];
+    positions[i + 2] = origin[2] + quantized[i + 2] * scale[2];
+  }
+  if(hasColors) {
+    for(i = 0; i < 3 * n; i++) {
+      colors[i] = frame[offset + i] / 255;
+    }
+  } else {
+    for(i = 0; i < 3 * n; i++) {
+      colors[i] = 1;
+    }
+  }
+
+  var attributes = this.geometry.attributes;
+  attributes.position.array = positions;
+  attributes.position.numItems = 3 * n;
+  attributes.position.needsUpdate = true;
+  attributes.color.array = colors;
+  attributes.color.numItems = 3 * n;
+  attributes.color.needsUpdate = true;
+
+  if(this.sceneNode === null || this.sceneNode.frameID !== frameID) {
+    if(this.sceneNode !== null) {
+      this.tfClient.unsubscribe(this.sceneNode.frameID, this.sceneNode.tfUpdate);
+      this.sceneNode.remove(this.particles);
+      this.rootObject.remove(this.sceneNode);
+    }
+    this.sceneNode = new ROS3D.SceneNode({
+      frameID : frameID,
+      tfClient : this.tfClient,
+      object : this.particles
+    });
+    this.rootObject.add(this.sceneNode);
+  }
+};
@@ -168,6 +168,19 @@ class MongoWrapper(object):
             small = cv2.resize(image, (0, 0), fx=scale_factor, fy=scale_factor)
             return small
 
+    def get_scene_frame(self, ts):
+        # full size BGR frame of the scene at ts, as (width, height, data); None if there is none
+        scene_cursor = self.db.scene.find({'timestamp': ts})
+        if scene_cursor.count() == 0:
+            return None
+        cas_document = self.db.cas.find({'_id': scene_cursor[0]['_parent']})
+        if cas_document.count() == 0:
+            return None
+        color_cursor = self.db.color_image_hd.find({'_id': cas_document[0]['color_image_hd']})
+        if color_cursor.count() == 0:
+            return None
+        return color_cursor[0]['cols'], color_cursor[0]['rows'], bytes(color_cursor[0]['data'])
+
     def get_scene_images(self, timestamps):
         images = []
         for ts in timestamps:
@@ -36,7 +36,7 @@ function RoboSherlock(options){
         
         $.ajax({
            type: "POST",
-           url: "/prolog_query",
+           url: "prolog_query",
            data: q, // serializes the form's elements.
            async: true,
            beforeSend: function(xhr){xhr.setRequestHeader('Content-type', 'text-plain');},
@@ -55,7 +55,7 @@ function RoboSherlock(options){
         if(!that.queryData) {
             try {
                 var xmlHttp = new XMLHttpRequest();
-                xmlHttp.open("GET", "/_get_queries", true); // true for asynchronous 
+                xmlHttp.open("GET", "_get_queries", true); // true for asynchronous 
                 xmlHttp.onload = function(e) { 
                     if (xmlHttp.readyState == 4 && xmlHttp.status == 200)
                     {
@@ -0,0 +1,267 @@
+#ifndef ACCESS_LOG_HTTP_HPP
+#define	ACCESS_LOG_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+
+namespace SimpleWeb {
+    ///Writes one line per response to a log file, rotated by size. Request threads only copy a fixed-size record
+    ///into a ring buffer of their own; a background thread formats the records and writes them in batches.
+    ///Records that do not fit into a full ring buffer are dropped and counted.
+    class AccessLog {
+    public:
+        class Config {
+            friend class AccessLog;
+
+            Config(const std::string &path): path(path), ring_size(8192), max_file_size(64*1024*1024), max_files(5), flush_interval(200) {}
+        public:
+            std::string path;
+            /// Records per thread-local ring buffer, rounded up to a power of two. Set before calling start().
+            size_t ring_size;
+            /// The log file is rotated to path.1, path.2, ... when it grows beyond this size in bytes.
+            size_t max_file_size;
+            /// Number of rotated files kept besides the current one.
+            size_t max_files;
+            /// Milliseconds between two batches written by the background thread.
+            size_t flush_interval;
+        };
+
+        Config config;
+
+        AccessLog(const std::string &path): config(path), id(next_id()), running(false), file(nullptr), file_size(0), total_dropped(0) {}
+
+        ~AccessLog() {
+            stop();
+        }
+
+        ///Logs every response of server. Call before server.start().
+        template<class socket_type>
+        void attach(ServerBase<socket_type> &server) {
+            //Functions set on on_response already, such as a RequestTimer, keep being called
+            auto previous=server.on_response;
+            server.on_response=[this, previous](const typename ServerBase<socket_type>::Request &request, unsigned short status_code, size_t bytes,
+                                                std::chrono::steady_clock::duration latency) {
+                if(previous)
+                    previous(request, status_code, bytes, latency);
+                record(request.method, request.remote_endpoint_address, request.remote_endpoint_port, request.resource_path,
+                       status_code, bytes, latency);
+            };
+        }
+
+        void start() {
+            std::lock_guard<std::mutex> lock(thread_mutex);
+            if(running)
+                return;
+            running=true;
+            writer=std::thread([this] {
+                write_loop();
+            });
+        }
+
+        ///Writes what has been recorded so far, and stops the background thread.
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(thread_mutex);
+                if(!running)
+                    return;
+                running=false;
+            }
+            stop_condition.notify_all();
+            writer.join();
+        }
+
+        ///Number of records dropped because a ring buffer was full.
+        uint64_t dropped() const {
+            return total_dropped.load(std::memory_order_relaxed);
+        }
+
+        void record(const std::string &method, const std::string &remote_address, unsigned short remote_port, const std::string *resource_path,
+                    unsigned short status_code, size_t bytes, std::chrono::steady_clock::duration latency) {
+            auto &ring=thread_ring();
+            auto tail=ring.tail.load(std::memory_order_relaxed);
+            if(tail-ring.head.load(std::memory_order_acquire)>ring.mask) {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto &entry=ring.records[tail&ring.mask];
+            entry.time=std::chrono::system_clock::now().time_since_epoch().count();
+            entry.latency=std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+            entry.bytes=bytes;
+            entry.resource_path=resource_path;
+            entry.status_code=status_code;
+            entry.remote_port=remote_port;
+            copy(entry.method, sizeof(entry.method), method);
+            copy(entry.remote_address, sizeof(entry.remote_address), remote_address);
+            ring.tail.store(tail+1, std::memory_order_release);
+        }
+
+    private:
+        class Record {
+        public:
+            std::chrono::system_clock::rep time;
+            int64_t latency;
+            uint64_t bytes;
+            const std::string *resource_path;
+            unsigned short status_code;
+            unsigned short remote_port;
+            char method[12];
+            char remote_address[46];
+        };
+
+        ///Single producer (one request thread), single consumer (the background thread)
+        class Ring {
+        public:
+            Ring(size_t size): records(size), mask(size-1), head(0), tail(0), dropped(0) {}
+            std::vector<Record> records;
+            const size_t mask;
+            std::atomic<size_t> head;
+            char padding[64];
+            std::atomic<size_t> tail;
+            std::atomic<uint64_t> dropped;
+        };
+
+        const uint64_t id;
+        std::mutex rings_mutex;
+        std::vector<std::unique_ptr<Ring> > rings;
+
+        std::mutex thread_mutex;
+        std::condition_variable stop_condition;
+        bool running;
+        std::thread writer;
+
+        FILE *file;
+        size_t file_size;
+        std::atomic<uint64_t> total_dropped;
+
+        static void copy(char *destination, size_t size, const std::string &source) {
+            auto length=std::min(size-1, source.size());
+            std::memcpy(destination, source.data(), length);
+            destination[length]='\0';
+        }
+
+        static uint64_t next_id() {
+            static std::atomic<uint64_t> id(0);
+            return ++id;
+        }
+
+        Ring &thread_ring() {
+            //Each thread caches the ring of the access log it last wrote to
+            thread_local uint64_t owner=0;
+            thread_local Ring *ring=nullptr;
+            if(owner!=id) {
+                size_t size=1;
+                while(size<config.ring_size)
+                    size<<=1;
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                rings.emplace_back(new Ring(size));
+                ring=rings.back().get();
+                owner=id;
+            }
+            return *ring;
+        }
+
+        void write_loop() {
+            std::string batch;
+            while(true) {
+                bool stopping;
+                {
+                    std::unique_lock<std::mutex> lock(thread_mutex);
+                    stop_condition.wait_for(lock, std::chrono::milliseconds(config.flush_interval), [this] {
+                        return !running;
+                    });
+                    stopping=!running;
+                }
+
+                batch.clear();
+                {
+                    std::lock_guard<std::mutex> lock(rings_mutex);
+                    for(auto &ring: rings)
+                        drain(*ring, batch);
+                }
+                if(!batch.empty())
+                    write(batch);
+                if(stopping)
+                    break;
+            }
+            if(file) {
+                std::fclose(file);
+                file=nullptr;
+            }
+        }
+
+        void drain(Ring &ring, std::string &batch) {
+            auto head=ring.head.load(std::memory_order_relaxed);
+            auto tail=ring.tail.load(std::memory_order_acquire);
+            char line[256];
+            for(;head!=tail;head++) {
+                auto &entry=ring.records[head&ring.mask];
+                auto time_point=std::chrono::system_clock::time_point(std::chrono::system_clock::duration(entry.time));
+                auto seconds=std::chrono::system_clock::to_time_t(time_point);
+                auto milliseconds=std::chrono::duration_cast<std::chrono::milliseconds>(time_point.time_since_epoch()).count()%1000;
+                std::tm tm;
+                gmtime_r(&seconds, &tm);
+                char time_string[32];
+                std::strftime(time_string, sizeof(time_string), "%Y-%m-%dT%H:%M:%S", &tm);
+                auto length=std::snprintf(line, sizeof(line), "%s.%03dZ %s %u %s %s %u %llu %lldus\n", time_string, static_cast<int>(milliseconds),
+                                          entry.remote_address, static_cast<unsigned>(entry.remote_port), entry.method,
+                                          entry.resource_path?entry.resource_path->c_str():"-", static_cast<unsigned>(entry.status_code),
+                                          static_cast<unsigned long long>(entry.bytes), static_cast<long long>(entry.latency));
+                if(length>0)
+                    batch.append(line, std::min(static_cast<size_t>(length), sizeof(line)-1));
+            }
+            ring.head.store(head, std::memory_order_release);
+
+            auto dropped=ring.dropped.exchange(0, std::memory_order_relaxed);
+            if(dropped>0) {
+                total_dropped.fetch_add(dropped, std::memory_order_relaxed);
+                auto length=std::snprintf(line, sizeof(line), "dropped %llu records\n", static_cast<unsigned long long>(dropped));
+                if(length>0)
+                    batch.append(line, static_cast<size_t>(length));
+            }
+        }
+
+        void write(const std::string &batch) {
+            if(file && file_size+batch.size()>config.max_file_size) {
+                std::fclose(file);
+                file=nullptr;
+                rotate();
+            }
+            if(!file) {
+                file=std::fopen(config.path.c_str(), "a");
+                if(!file)
+                    return;
+                std::fseek(file, 0, SEEK_END);
+                file_size=static_cast<size_t>(std::ftell(file));
+            }
+            std::fwrite(batch.data(), 1, batch.size(), file);
+            std::fflush(file);
+            file_size+=batch.size();
+        }
+
+        void rotate() {
+            if(config.max_files==0) {
+                std::remove(config.path.c_str());
+                return;
+            }
+            std::remove((config.path+'.'+std::to_string(config.max_files)).c_str());
+            for(size_t c=config.max_files;c>1;c--)
+                std::rename((config.path+'.'+std::to_string(c-1)).c_str(), (config.path+'.'+std::to_string(c)).c_str());
+            std::rename(config.path.c_str(), (config.path+".1").c_str());
+        }
+    };
+}
+
+#endif	/* ACCESS_LOG_HTTP_HPP */
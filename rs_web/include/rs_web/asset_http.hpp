@@ -0,0 +1,271 @@
+#ifndef ASSET_HTTP_HPP
+#define	ASSET_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/stat.h>
+
+namespace SimpleWeb {
+    ///Finds the files under a web root that have identical content, such as the copies of a library in two directories,
+    ///and serves that content once under a fingerprinted URL /_a/<hash>.<extension>, whose content never changes and can
+    ///be cached indefinitely. Requests for the paths of the copies are redirected there, so that a browser downloads and
+    ///caches the content once, whichever of the paths its pages use. GET /_a/manifest.json maps these paths to their URLs.
+    ///
+    ///Only content shared by several paths is kept in memory; other files are left to be read from disk. A path whose
+    ///file has changed since construction is no longer redirected.
+    template <class socket_type>
+    class AssetStore {
+    public:
+        ///Hashes the files under root, which should be canonical. Files larger than max_file_size are left out, and so
+        ///are symbolic links to files outside of root.
+        AssetStore(const boost::filesystem::path &root, size_t max_file_size=16*1024*1024): stored_bytes(0) {
+            auto root_string=root.string();
+            auto root_length=root_string.size();
+            std::map<std::string, std::vector<Copy> > copies;
+            for(boost::filesystem::recursive_directory_iterator it(root), end;it!=end;it++) {
+                if(!boost::filesystem::is_regular_file(it->status()) || boost::filesystem::file_size(it->path())>max_file_size)
+                    continue;
+                auto extension=it->path().extension().string();
+                if(!relocatable(extension))
+                    continue;
+                boost::system::error_code ec;
+                auto target=boost::filesystem::canonical(it->path(), ec).string();
+                if(ec || target.compare(0, root_length, root_string)!=0 || target.size()<=root_length || target[root_length]!='/')
+                    continue;
+                Copy copy;
+                copy.file=it->path().string();
+                std::string content;
+                if(!modification(copy.file, copy.modified) || !read(copy.file, content))
+                    continue;
+                copy.path=copy.file.substr(root_length);
+                copies[hash(content)+extension].emplace_back(std::move(copy));
+            }
+
+            //Copies are read again to rule out hash collisions, which keeps only shared content in memory
+            std::map<std::string, std::string> manifest_entries;
+            for(auto &key_copies: copies) {
+                if(key_copies.second.size()<2)
+                    continue;
+                auto content=std::make_shared<std::string>();
+                if(!read(key_copies.second.front().file, *content))
+                    continue;
+                std::vector<Copy*> identical;
+                for(auto &copy: key_copies.second) {
+                    std::string copy_content;
+                    if(read(copy.file, copy_content) && copy_content==*content)
+                        identical.emplace_back(&copy);
+                }
+                if(identical.size()<2)
+                    continue;
+                auto extension=boost::filesystem::path(identical.front()->path).extension().string();
+                auto asset=std::make_shared<Asset>();
+                asset->content=content;
+                asset->etag='"'+key_copies.first+'"';
+                asset->content_type=content_type(extension);
+                asset->url="/_a/"+key_copies.first;
+                stored_bytes+=content->size();
+                hashes.emplace(key_copies.first, asset);
+                for(auto copy: identical) {
+                    auto path=std::make_shared<Path>();
+                    path->asset=asset;
+                    path->file=copy->file;
+                    path->modified=copy->modified;
+                    paths.emplace(copy->path, path);
+                    manifest_entries.emplace(copy->path, asset->url);
+                }
+            }
+
+            std::ostringstream json;
+            json << '{';
+            for(auto &entry: manifest_entries)
+                json << (json.tellp()>1?",":"") << '"' << json_escape(entry.first) << "\":\"" << json_escape(entry.second) << '"';
+            json << '}';
+            auto manifest=std::make_shared<Asset>();
+            manifest->content=std::make_shared<const std::string>(json.str());
+            manifest->etag='"'+hash(*manifest->content)+'"';
+            manifest->content_type="application/json";
+            this->manifest=manifest;
+        }
+
+        ///Adds the /_a/ resources to server. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.resource["^/_a/manifest\\.json$"]["GET"]=[this](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                 std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                write(response, request, manifest, "no-cache");
+            };
+            server.resource["^/_a/([0-9a-f]{16})(\\.[A-Za-z0-9]+)?$"]["GET"]=[this](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                                  std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                //The extension has to be the one the URL was made with, which determines the Content-Type
+                auto it=hashes.find(request->path_match[1].str()+request->path_match[2].str());
+                if(it==hashes.end()) {
+                    *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                    return;
+                }
+                write(response, request, it->second, "public, max-age=31536000, immutable");
+            };
+        }
+
+        ///Redirects a request for path, relative to the root and starting with '/', to the fingerprinted URL of its content.
+        ///Returns false if path has no shared content, or its file has changed, in which case it is to be read from disk.
+        bool redirect(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response, const std::string &path) const {
+            auto it=paths.find(path);
+            if(it==paths.end() || !it->second->unchanged())
+                return false;
+            //The path may lead elsewhere once the store has been constructed again, so the redirect is revalidated
+            *response << "HTTP/1.1 301 Moved Permanently\r\nLocation: " << it->second->asset->url
+                      << "\r\nCache-Control: no-cache\r\nContent-Length: 0\r\n\r\n";
+            return true;
+        }
+
+        ///Bytes of shared content held in memory
+        size_t bytes() const {
+            return stored_bytes;
+        }
+
+    private:
+        typedef std::pair<int64_t, int64_t> version_type;
+
+        class Asset {
+        public:
+            std::shared_ptr<const std::string> content;
+            std::string etag;
+            std::string content_type;
+            std::string url;
+        };
+
+        ///A path with shared content. Whether its file has changed is checked at most once a second, since it is a
+        ///file system call on the thread serving the request.
+        class Path {
+        public:
+            Path(): checked(0), changed(false) {}
+            std::shared_ptr<const Asset> asset;
+            std::string file;
+            version_type modified;
+            mutable std::atomic<std::chrono::steady_clock::rep> checked;
+            mutable std::atomic<bool> changed;
+
+            bool unchanged() const {
+                auto now=std::chrono::steady_clock::now().time_since_epoch();
+                if(now-std::chrono::steady_clock::duration(checked.load(std::memory_order_relaxed))>=std::chrono::seconds(1)) {
+                    checked.store(now.count(), std::memory_order_relaxed);
+                    version_type current;
+                    if(!modification(file, current) || current!=modified)
+                        changed=true;
+                }
+                return !changed;
+            }
+        };
+
+        class Copy {
+        public:
+            std::string path, file;
+            version_type modified;
+        };
+
+        std::unordered_map<std::string, std::shared_ptr<const Path> > paths;
+        ///Assets by hash and extension, as in their URL
+        std::unordered_map<std::string, std::shared_ptr<const Asset> > hashes;
+        std::shared_ptr<const Asset> manifest;
+        size_t stored_bytes;
+
+        ///Pages and style sheets are left out, since their relative references would resolve against /_a/ after a redirect
+        static bool relocatable(const std::string &extension) {
+            return extension!=".html" && extension!=".htm" && extension!=".css" && extension!=".svg";
+        }
+
+        ///Sets version to the modification time of file in nanoseconds and its size
+        static bool modification(const std::string &file, version_type &version) {
+            struct stat file_stat;
+            if(::stat(file.c_str(), &file_stat)!=0)
+                return false;
+            version.first=static_cast<int64_t>(file_stat.st_mtim.tv_sec)*1000000000+file_stat.st_mtim.tv_nsec;
+            version.second=static_cast<int64_t>(file_stat.st_size);
+            return true;
+        }
+
+        static bool read(const std::string &file, std::string &content) {
+            std::ifstream stream(file, std::ios::binary);
+            if(!stream)
+                return false;
+            std::ostringstream buffer;
+            buffer << stream.rdbuf();
+            content=buffer.str();
+            return true;
+        }
+
+        void write(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response,
+                   const std::shared_ptr<typename ServerBase<socket_type>::Request> &request, const std::shared_ptr<const Asset> &asset,
+                   const char *cache_control) const {
+            auto range=request->header.equal_range("If-None-Match");
+            for(auto it=range.first;it!=range.second;it++) {
+                if(it->second.find(asset->etag)!=std::string::npos || it->second=="*") {
+                    *response << "HTTP/1.1 304 Not Modified\r\nETag: " << asset->etag << "\r\nCache-Control: " << cache_control << "\r\n\r\n";
+                    return;
+                }
+            }
+            *response << "HTTP/1.1 200 OK\r\n";
+            if(!asset->content_type.empty())
+                *response << "Content-Type: " << asset->content_type << "\r\n";
+            *response << "Content-Length: " << asset->content->size() << "\r\nETag: " << asset->etag << "\r\nCache-Control: " << cache_control << "\r\n\r\n";
+            //The content is sent from the store, and kept alive until it has been written
+            if(request->method!="HEAD")
+                response->write(asset->content);
+        }
+
+        ///64-bit FNV-1a of content, in hexadecimal
+        static std::string hash(const std::string &content) {
+            uint64_t value=14695981039346656037ULL;
+            for(auto c: content) {
+                value^=static_cast<unsigned char>(c);
+                value*=1099511628211ULL;
+            }
+            char hex[17];
+            std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(value));
+            return hex;
+        }
+
+        static std::string json_escape(const std::string &value) {
+            std::string escaped;
+            for(auto c: value) {
+                if(c=='"' || c=='\\')
+                    escaped+='\\';
+                if(static_cast<unsigned char>(c)<0x20) {
+                    char code[7];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                    escaped+=code;
+                }
+                else
+                    escaped+=c;
+            }
+            return escaped;
+        }
+
+        static std::string content_type(const std::string &extension) {
+            static const std::unordered_map<std::string, std::string> types={
+                {".html", "text/html; charset=utf-8"}, {".htm", "text/html; charset=utf-8"}, {".css", "text/css"},
+                {".js", "application/javascript"}, {".json", "application/json"}, {".map", "application/json"},
+                {".png", "image/png"}, {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"}, {".gif", "image/gif"},
+                {".svg", "image/svg+xml"}, {".ico", "image/x-icon"}, {".woff", "font/woff"}, {".woff2", "font/woff2"},
+                {".txt", "text/plain; charset=utf-8"}
+            };
+            auto it=types.find(extension);
+            return it!=types.end()?it->second:std::string();
+        }
+    };
+}
+
+#endif	/* ASSET_HTTP_HPP */
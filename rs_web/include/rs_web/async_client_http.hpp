@@ -0,0 +1,422 @@
+#ifndef ASYNC_CLIENT_HTTP_HPP
+#define	ASYNC_CLIENT_HTTP_HPP
+
+#include <rs_web/client_http.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <sstream>
+
+namespace SimpleWeb {
+    ///Asynchronous HTTP/1.1 client running on a shared io_service, for use from inside resource functions.
+    ///Keep-alive connections to the upstream host are pooled and reused between requests.
+    class AsyncClient {
+    public:
+        class Response {
+            friend class AsyncClient;
+
+            class iequal_to {
+            public:
+              bool operator()(const std::string &key1, const std::string &key2) const {
+                return boost::algorithm::iequals(key1, key2);
+              }
+            };
+            class ihash {
+            public:
+              size_t operator()(const std::string &key) const {
+                std::size_t seed=0;
+                for(auto &c: key)
+                  boost::hash_combine(seed, std::tolower(c));
+                return seed;
+              }
+            };
+        public:
+            std::string http_version, status_code;
+
+            std::unordered_multimap<std::string, std::string, ihash, iequal_to> header;
+
+            std::string content;
+        };
+
+        class Config {
+            friend class AsyncClient;
+        private:
+            Config() {}
+        public:
+            /// Set timeout on requests in seconds. Default value: 30 (0 disables the timeout).
+            size_t timeout=30;
+            /// Maximum number of idle keep-alive connections kept in the pool. Default value: 16.
+            size_t max_idle_connections=16;
+            /// Seconds a resolved address list is kept in the shared ResolverCache. Default value: 60 (0 disables the cache).
+            size_t dns_cache_ttl=60;
+        };
+
+        /// Set before calling request
+        Config config;
+
+        typedef std::function<void(const boost::system::error_code&, std::shared_ptr<Response>)> callback_type;
+
+        AsyncClient(boost::asio::io_service &io_service, const std::string &host_port) :
+                io_service(io_service), resolver(io_service) {
+            size_t host_end=host_port.find(':');
+            if(host_end==std::string::npos) {
+                host=host_port;
+                port=80;
+            }
+            else {
+                host=host_port.substr(0, host_end);
+                port=static_cast<unsigned short>(stoul(host_port.substr(host_end+1)));
+            }
+        }
+
+        ///The callback is called exactly once, on one of the io_service threads.
+        void request(const std::string &request_type, const std::string &path, const std::string &content,
+                     const std::map<std::string, std::string> &header, const callback_type &callback) {
+            auto corrected_path=path.empty()?"/":path;
+            auto write_buffer=std::make_shared<std::string>();
+            std::ostringstream write_stream;
+            write_stream << request_type << " " << corrected_path << " HTTP/1.1\r\n";
+            bool has_host=false;
+            for(auto &h: header) {
+                if(boost::iequals(h.first, "Host"))
+                    has_host=true;
+                write_stream << h.first << ": " << h.second << "\r\n";
+            }
+            if(!has_host)
+                write_stream << "Host: " << host << "\r\n";
+            if(content.size()>0 || request_type=="POST" || request_type=="PUT")
+                write_stream << "Content-Length: " << content.size() << "\r\n";
+            write_stream << "\r\n" << content;
+            *write_buffer=write_stream.str();
+
+            auto transaction=std::make_shared<Transaction>();
+            transaction->request_type=request_type;
+            transaction->write_buffer=write_buffer;
+            transaction->callback=callback;
+
+            std::shared_ptr<Connection> connection;
+            {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                if(!idle_connections.empty()) {
+                    connection=idle_connections.back();
+                    idle_connections.pop_back();
+                }
+            }
+            if(connection) {
+                transaction->reused_connection=true;
+                write_request(connection, transaction);
+            }
+            else
+                connect(transaction);
+        }
+
+    private:
+        class Connection {
+        public:
+            Connection(boost::asio::io_service &io_service): socket(io_service), timer(io_service) {}
+            boost::asio::ip::tcp::socket socket;
+            boost::asio::streambuf streambuf;
+            boost::asio::deadline_timer timer;
+        };
+
+        class Transaction {
+        public:
+            Transaction(): reused_connection(false), keep_alive(true) {}
+            std::string request_type;
+            std::shared_ptr<std::string> write_buffer;
+            callback_type callback;
+            std::shared_ptr<Response> response;
+            bool reused_connection;
+            bool keep_alive;
+        };
+
+        boost::asio::io_service &io_service;
+        boost::asio::ip::tcp::resolver resolver;
+        std::string host;
+        unsigned short port;
+
+        std::mutex idle_mutex;
+        std::vector<std::shared_ptr<Connection> > idle_connections;
+
+        void connect(const std::shared_ptr<Transaction> &transaction) {
+            auto connection=std::make_shared<Connection>(io_service);
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+            if(config.dns_cache_ttl>0 && ResolverCache::instance().find(host, port, endpoints))
+                connect_endpoints(connection, transaction, std::make_shared<std::vector<boost::asio::ip::tcp::endpoint> >(std::move(endpoints)));
+            else {
+                boost::asio::ip::tcp::resolver::query query(host, std::to_string(port));
+                resolver.async_resolve(query, [this, connection, transaction](const boost::system::error_code &ec,
+                                                                              boost::asio::ip::tcp::resolver::iterator it) {
+                    if(ec) {
+                        transaction->callback(ec, nullptr);
+                        return;
+                    }
+                    auto endpoints=std::make_shared<std::vector<boost::asio::ip::tcp::endpoint> >();
+                    for(;it!=boost::asio::ip::tcp::resolver::iterator();it++)
+                        endpoints->emplace_back(it->endpoint());
+                    if(config.dns_cache_ttl>0)
+                        ResolverCache::instance().insert(host, port, *endpoints, config.dns_cache_ttl);
+                    connect_endpoints(connection, transaction, endpoints);
+                });
+            }
+        }
+
+        void connect_endpoints(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction,
+                               const std::shared_ptr<std::vector<boost::asio::ip::tcp::endpoint> > &endpoints) {
+            start_timer(connection);
+            boost::asio::async_connect(connection->socket, endpoints->begin(), endpoints->end(),
+                                       [this, connection, transaction, endpoints](const boost::system::error_code &ec,
+                                                                                  std::vector<boost::asio::ip::tcp::endpoint>::iterator /*it*/) {
+                connection->timer.cancel();
+                if(ec) {
+                    ResolverCache::instance().erase(host, port);
+                    transaction->callback(ec, nullptr);
+                    return;
+                }
+                boost::asio::ip::tcp::no_delay option(true);
+                boost::system::error_code option_ec;
+                connection->socket.set_option(option, option_ec);
+                write_request(connection, transaction);
+            });
+        }
+
+        void start_timer(const std::shared_ptr<Connection> &connection) {
+            if(config.timeout==0)
+                return;
+            connection->timer.expires_from_now(boost::posix_time::seconds(config.timeout));
+            std::weak_ptr<Connection> weak_connection=connection;
+            connection->timer.async_wait([weak_connection](const boost::system::error_code &ec) {
+                auto connection=weak_connection.lock();
+                if(!ec && connection) {
+                    boost::system::error_code ec;
+                    connection->socket.close(ec);
+                }
+            });
+        }
+
+        ///A pooled connection may have been closed by the upstream while idle, in which case the request is retried once on a new connection.
+        ///Only idempotent requests are retried, since the upstream may have acted on the request before closing.
+        bool retry_on_stale(const boost::system::error_code &ec, const std::shared_ptr<Transaction> &transaction) {
+            auto &method=transaction->request_type;
+            if(transaction->reused_connection && !transaction->response &&
+               (method=="GET" || method=="HEAD" || method=="OPTIONS") &&
+               (ec==boost::asio::error::eof || ec==boost::asio::error::connection_reset || ec==boost::asio::error::broken_pipe)) {
+                transaction->reused_connection=false;
+                connect(transaction);
+                return true;
+            }
+            return false;
+        }
+
+        void write_request(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            start_timer(connection);
+            boost::asio::async_write(connection->socket, boost::asio::buffer(*transaction->write_buffer),
+                                     [this, connection, transaction](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                if(ec) {
+                    connection->timer.cancel();
+                    if(!retry_on_stale(ec, transaction))
+                        transaction->callback(ec, nullptr);
+                    return;
+                }
+                read_response_header(connection, transaction);
+            });
+        }
+
+        void read_response_header(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            boost::asio::async_read_until(connection->socket, connection->streambuf, "\r\n\r\n",
+                                          [this, connection, transaction](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                if(ec) {
+                    connection->timer.cancel();
+                    if(!retry_on_stale(ec, transaction))
+                        transaction->callback(ec, nullptr);
+                    return;
+                }
+
+                transaction->response=std::make_shared<Response>();
+                auto &response=*transaction->response;
+                std::istream stream(&connection->streambuf);
+                std::string line;
+                getline(stream, line);
+                size_t version_end=line.find(' ');
+                if(version_end!=std::string::npos) {
+                    if(5<line.size())
+                        response.http_version=line.substr(5, version_end-5);
+                    if((version_end+1)<line.size())
+                        response.status_code=line.substr(version_end+1, line.size()-(version_end+1)-1);
+                }
+                getline(stream, line);
+                size_t param_end;
+                while((param_end=line.find(':'))!=std::string::npos) {
+                    size_t value_start=param_end+1;
+                    if((value_start)<line.size()) {
+                        if(line[value_start]==' ')
+                            value_start++;
+                        if(value_start<line.size())
+                            response.header.insert(std::make_pair(line.substr(0, param_end), line.substr(value_start, line.size()-value_start-1)));
+                    }
+                    getline(stream, line);
+                }
+
+                if(response.http_version=="1.0")
+                    transaction->keep_alive=false;
+                auto range=response.header.equal_range("Connection");
+                for(auto it=range.first;it!=range.second;it++) {
+                    if(boost::iequals(it->second, "close"))
+                        transaction->keep_alive=false;
+                }
+
+                if(transaction->request_type=="HEAD" || response.status_code.compare(0, 1, "1")==0 ||
+                   response.status_code.compare(0, 3, "204")==0 || response.status_code.compare(0, 3, "304")==0) {
+                    finish(connection, transaction);
+                    return;
+                }
+
+                auto it=response.header.find("Content-Length");
+                if(it!=response.header.end()) {
+                    unsigned long long content_length;
+                    try {
+                        content_length=stoull(it->second);
+                    }
+                    catch(const std::exception &) {
+                        connection->timer.cancel();
+                        transaction->callback(boost::asio::error::invalid_argument, nullptr);
+                        return;
+                    }
+                    read_content(connection, transaction, content_length);
+                }
+                else if((it=response.header.find("Transfer-Encoding"))!=response.header.end() && boost::iequals(it->second, "chunked"))
+                    read_chunked(connection, transaction);
+                else {
+                    transaction->keep_alive=false;
+                    read_until_eof(connection, transaction);
+                }
+            });
+        }
+
+        void append_content(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction, size_t length) {
+            auto data=boost::asio::buffer_cast<const char*>(connection->streambuf.data());
+            transaction->response->content.append(data, length);
+            connection->streambuf.consume(length);
+        }
+
+        void read_content(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction,
+                          unsigned long long content_length) {
+            if(connection->streambuf.size()>=content_length) {
+                append_content(connection, transaction, static_cast<size_t>(content_length));
+                finish(connection, transaction);
+                return;
+            }
+            //The Content-Length comes from the upstream, so at most 1 MB is reserved ahead of the content arriving
+            transaction->response->content.reserve(static_cast<size_t>(std::min(content_length, 1024ULL*1024)));
+            boost::asio::async_read(connection->socket, connection->streambuf,
+                                    boost::asio::transfer_exactly(static_cast<size_t>(content_length)-connection->streambuf.size()),
+                                    [this, connection, transaction, content_length](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                if(ec) {
+                    connection->timer.cancel();
+                    transaction->callback(ec, nullptr);
+                    return;
+                }
+                append_content(connection, transaction, static_cast<size_t>(content_length));
+                finish(connection, transaction);
+            });
+        }
+
+        void read_chunked(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            boost::asio::async_read_until(connection->socket, connection->streambuf, "\r\n",
+                                          [this, connection, transaction](const boost::system::error_code &ec, size_t bytes_transferred) {
+                if(ec) {
+                    connection->timer.cancel();
+                    transaction->callback(ec, nullptr);
+                    return;
+                }
+                std::string line(boost::asio::buffer_cast<const char*>(connection->streambuf.data()), bytes_transferred-2);
+                connection->streambuf.consume(bytes_transferred);
+                size_t length;
+                try {
+                    length=stoul(line, 0, 16);
+                }
+                catch(const std::exception &) {
+                    connection->timer.cancel();
+                    transaction->callback(boost::asio::error::invalid_argument, nullptr);
+                    return;
+                }
+                if(length==0) {
+                    read_chunked_trailer(connection, transaction);
+                    return;
+                }
+
+                auto post_process=[this, connection, transaction, length] {
+                    append_content(connection, transaction, length);
+                    connection->streambuf.consume(2);
+                    read_chunked(connection, transaction);
+                };
+                if(connection->streambuf.size()>=length+2)
+                    post_process();
+                else {
+                    boost::asio::async_read(connection->socket, connection->streambuf,
+                                            boost::asio::transfer_exactly(length+2-connection->streambuf.size()),
+                                            [this, connection, transaction, post_process](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                        if(ec) {
+                            connection->timer.cancel();
+                            transaction->callback(ec, nullptr);
+                            return;
+                        }
+                        post_process();
+                    });
+                }
+            });
+        }
+
+        void read_chunked_trailer(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            boost::asio::async_read_until(connection->socket, connection->streambuf, "\r\n",
+                                          [this, connection, transaction](const boost::system::error_code &ec, size_t bytes_transferred) {
+                if(ec) {
+                    connection->timer.cancel();
+                    transaction->callback(ec, nullptr);
+                    return;
+                }
+                connection->streambuf.consume(bytes_transferred);
+                if(bytes_transferred>2)
+                    read_chunked_trailer(connection, transaction);
+                else
+                    finish(connection, transaction);
+            });
+        }
+
+        void read_until_eof(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            boost::asio::async_read(connection->socket, connection->streambuf, boost::asio::transfer_at_least(1),
+                                    [this, connection, transaction](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                append_content(connection, transaction, connection->streambuf.size());
+                if(ec==boost::asio::error::eof)
+                    finish(connection, transaction);
+                else if(ec) {
+                    connection->timer.cancel();
+                    transaction->callback(ec, nullptr);
+                }
+                else
+                    read_until_eof(connection, transaction);
+            });
+        }
+
+        void finish(const std::shared_ptr<Connection> &connection, const std::shared_ptr<Transaction> &transaction) {
+            connection->timer.cancel();
+            //Responses are only reused when nothing unexpected is left in the buffer
+            if(transaction->keep_alive && connection->streambuf.size()==0 && connection->socket.is_open()) {
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                if(idle_connections.size()<config.max_idle_connections)
+                    idle_connections.emplace_back(connection);
+            }
+            transaction->callback(boost::system::error_code(), transaction->response);
+        }
+    };
+}
+
+#endif	/* ASYNC_CLIENT_HTTP_HPP */
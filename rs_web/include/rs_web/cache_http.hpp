@@ -0,0 +1,184 @@
+#ifndef CACHE_HTTP_HPP
+#define	CACHE_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+namespace SimpleWeb {
+    ///Caches complete responses of resource functions whose output only depends on method, path and
+    ///a configurable set of request headers. The cache is split into lock-striped shards, each evicting
+    ///least recently used entries when over its share of the byte budget. Concurrent misses on the same
+    ///key run the resource function only once.
+    ///
+    ///Only wrap resource functions that are safe to share between clients: cached responses are replayed verbatim.
+    template <class socket_type>
+    class ResponseCache {
+    public:
+        typedef std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>,
+                                   std::shared_ptr<typename ServerBase<socket_type>::Request>)> resource_function;
+
+        class Config {
+            friend class ResponseCache<socket_type>;
+
+            Config(size_t max_bytes, size_t num_shards): max_bytes(max_bytes), num_shards(num_shards) {}
+        public:
+            /// Total size of cached responses in bytes, divided evenly between the shards.
+            size_t max_bytes;
+            /// Number of independently locked shards. Cannot be changed after construction.
+            const size_t num_shards;
+            /// Request headers that are part of the cache key, for instance "Accept-Encoding".
+            std::vector<std::string> vary;
+        };
+
+        Config config;
+
+        ResponseCache(const ServerBase<socket_type> &server, size_t max_bytes=64*1024*1024, size_t num_shards=16) :
+                config(max_bytes, num_shards>0?num_shards:1), server(server), shards(config.num_shards) {}
+
+        ///Returns a resource function that serves responses of resource_function from the cache for ttl seconds.
+        ///Only "200 OK" responses are cached.
+        resource_function wrap(const resource_function &function, size_t ttl) {
+            return [this, function, ttl](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                         std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                serve(function, ttl, response, request);
+            };
+        }
+
+        void clear() {
+            for(auto &shard: shards) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.lru.clear();
+                shard.index.clear();
+                shard.bytes=0;
+            }
+        }
+
+    private:
+        typedef std::function<void(const std::shared_ptr<const std::string>&)> waiter_type;
+
+        class Entry {
+        public:
+            std::string key;
+            std::shared_ptr<const std::string> data;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        class Shard {
+        public:
+            Shard(): bytes(0) {}
+            std::mutex mutex;
+            std::list<Entry> lru;
+            std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+            size_t bytes;
+            std::unordered_map<std::string, std::vector<waiter_type> > in_flight;
+        };
+
+        const ServerBase<socket_type> &server;
+        std::vector<Shard> shards;
+
+        std::string key(const typename ServerBase<socket_type>::Request &request) const {
+            std::string key=request.method+' '+request.path;
+            for(auto &field: config.vary) {
+                key+='\n';
+                auto it=request.header.find(field);
+                if(it!=request.header.end())
+                    key+=it->second;
+            }
+            return key;
+        }
+
+        static bool is_cacheable(const std::string &data) {
+            //Status line is "HTTP/1.x 200 ..."
+            auto status_start=data.find(' ');
+            return status_start!=std::string::npos && data.compare(status_start+1, 3, "200")==0;
+        }
+
+        void serve(const resource_function &function, size_t ttl,
+                   const std::shared_ptr<typename ServerBase<socket_type>::Response> &response,
+                   const std::shared_ptr<typename ServerBase<socket_type>::Request> &request) {
+            auto request_key=key(*request);
+            auto &shard=shards[std::hash<std::string>()(request_key)%shards.size()];
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto it=shard.index.find(request_key);
+                if(it!=shard.index.end()) {
+                    if(std::chrono::steady_clock::now()<it->second->expires) {
+                        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                        response->write(it->second->data);
+                        return;
+                    }
+                    shard.bytes-=it->second->data->size();
+                    shard.lru.erase(it->second);
+                    shard.index.erase(it);
+                }
+
+                auto waiter=[response](const std::shared_ptr<const std::string> &data) {
+                    response->write(data);
+                };
+                auto in_flight_it=shard.in_flight.find(request_key);
+                if(in_flight_it!=shard.in_flight.end()) {
+                    in_flight_it->second.emplace_back(waiter);
+                    return;
+                }
+                shard.in_flight[request_key].emplace_back(waiter);
+            }
+
+            //Run the resource function against a detached response, and distribute its output once it is released
+            auto capture=server.create_detached_response([this, &shard, request_key, ttl](typename ServerBase<socket_type>::Response &captured) {
+                auto data=std::make_shared<std::string>(captured.size(), '\0');
+                if(!data->empty())
+                    captured.rdbuf()->sgetn(&(*data)[0], static_cast<std::streamsize>(data->size()));
+                std::shared_ptr<const std::string> shared_data=data;
+
+                std::vector<waiter_type> waiters;
+                {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    auto it=shard.in_flight.find(request_key);
+                    if(it!=shard.in_flight.end()) {
+                        waiters=std::move(it->second);
+                        shard.in_flight.erase(it);
+                    }
+                    if(ttl>0 && is_cacheable(*shared_data))
+                        insert(shard, request_key, shared_data, ttl);
+                }
+                for(auto &waiter: waiters)
+                    waiter(shared_data);
+            });
+            function(capture, request);
+        }
+
+        ///Called with shard.mutex locked
+        void insert(Shard &shard, const std::string &request_key, const std::shared_ptr<const std::string> &data, size_t ttl) {
+            auto shard_max_bytes=config.max_bytes/shards.size();
+            if(data->size()>shard_max_bytes)
+                return;
+            auto it=shard.index.find(request_key);
+            if(it!=shard.index.end()) {
+                shard.bytes-=it->second->data->size();
+                shard.lru.erase(it->second);
+                shard.index.erase(it);
+            }
+            while(!shard.lru.empty() && shard.bytes+data->size()>shard_max_bytes) {
+                shard.bytes-=shard.lru.back().data->size();
+                shard.index.erase(shard.lru.back().key);
+                shard.lru.pop_back();
+            }
+            Entry entry;
+            entry.key=request_key;
+            entry.data=data;
+            entry.expires=std::chrono::steady_clock::now()+std::chrono::seconds(ttl);
+            shard.lru.emplace_front(std::move(entry));
+            shard.index[request_key]=shard.lru.begin();
+            shard.bytes+=data->size();
+        }
+    };
+}
+
+#endif	/* CACHE_HTTP_HPP */
@@ -36,8 +36,77 @@ SOFTWARE.
 #include <random>
 #include <mutex>
 #include <type_traits>
+#include <vector>
+#include <chrono>
+#include <functional>
 
 namespace SimpleWeb {
+    /// Process-wide cache of resolved endpoints, shared by all clients so that reconnects skip the resolver.
+    /// Entries can also be inserted manually, for instance to pin a host to fixed addresses.
+    class ResolverCache {
+    public:
+        typedef boost::asio::ip::tcp::endpoint endpoint_type;
+        
+        static ResolverCache& instance() {
+            static ResolverCache cache;
+            return cache;
+        }
+        
+        bool find(const std::string &host, unsigned short port, std::vector<endpoint_type> &endpoints) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it=entries.find(key(host, port));
+            if(it==entries.end())
+                return false;
+            if(std::chrono::steady_clock::now()>=it->second.expires) {
+                entries.erase(it);
+                return false;
+            }
+            endpoints=it->second.endpoints;
+            return true;
+        }
+        
+        void insert(const std::string &host, unsigned short port, const std::vector<endpoint_type> &endpoints, size_t ttl_seconds) {
+            auto now=std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            //Drop expired entries so that the cache does not grow with every host ever contacted
+            for(auto it=entries.begin();it!=entries.end();) {
+                if(now>=it->second.expires)
+                    it=entries.erase(it);
+                else
+                    it++;
+            }
+            auto &entry=entries[key(host, port)];
+            entry.endpoints=endpoints;
+            entry.expires=now+std::chrono::seconds(ttl_seconds);
+        }
+        
+        void erase(const std::string &host, unsigned short port) {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.erase(key(host, port));
+        }
+        
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            entries.clear();
+        }
+        
+    private:
+        class Entry {
+        public:
+            std::vector<endpoint_type> endpoints;
+            std::chrono::steady_clock::time_point expires;
+        };
+        
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        
+        ResolverCache() {}
+        
+        static std::string key(const std::string &host, unsigned short port) {
+            return host+':'+std::to_string(port);
+        }
+    };
+    
     template <class socket_type>
     class ClientBase {
     public:
@@ -84,6 +153,10 @@ namespace SimpleWeb {
             size_t timeout=0;
             /// Set proxy server (server:port)
             std::string proxy_server;
+            /// Seconds a resolved address list is kept in the shared ResolverCache. Default value: 60 (0 disables the cache).
+            size_t dns_cache_ttl=60;
+            /// Milliseconds to wait before racing the next address when connecting (RFC 8305). Default value: 250.
+            size_t connect_attempt_delay=250;
         };
         
         /// Set before calling request
@@ -227,6 +300,135 @@ namespace SimpleWeb {
         
         virtual void connect()=0;
         
+        ///Resolves the host, or the proxy server if set, and connects to it. on_connect is called with the connected socket
+        ///while socket_mutex is held. Throws boost::system::system_error if no address can be connected to.
+        void connect_tcp(const std::function<void(boost::asio::ip::tcp::socket&&)> &on_connect) {
+            std::pair<std::string, unsigned short> host_port;
+            if(config.proxy_server.empty())
+                host_port=std::make_pair(host, port);
+            else
+                host_port=parse_host_port(config.proxy_server, 8080);
+            
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+            if(config.dns_cache_ttl>0 && ResolverCache::instance().find(host_port.first, host_port.second, endpoints))
+                connect_endpoints(host_port, endpoints, on_connect);
+            else {
+                boost::asio::ip::tcp::resolver::query query(host_port.first, std::to_string(host_port.second));
+                resolver.async_resolve(query, [this, host_port, on_connect](const boost::system::error_code &ec,
+                                                               boost::asio::ip::tcp::resolver::iterator it){
+                    if(!ec) {
+                        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+                        for(;it!=boost::asio::ip::tcp::resolver::iterator();it++)
+                            endpoints.emplace_back(it->endpoint());
+                        if(config.dns_cache_ttl>0)
+                            ResolverCache::instance().insert(host_port.first, host_port.second, endpoints, config.dns_cache_ttl);
+                        connect_endpoints(host_port, endpoints, on_connect);
+                    }
+                    else {
+                        std::lock_guard<std::mutex> lock(socket_mutex);
+                        socket=nullptr;
+                        throw boost::system::system_error(ec);
+                    }
+                });
+            }
+            io_service.reset();
+            io_service.run();
+        }
+        
+        class ConnectAttempts {
+        public:
+            ConnectAttempts(boost::asio::io_service &io_service, const std::pair<std::string, unsigned short> &host_port,
+                            std::vector<boost::asio::ip::tcp::endpoint> &&endpoints,
+                            const std::function<void(boost::asio::ip::tcp::socket&&)> &on_connect) :
+                    host_port(host_port), endpoints(std::move(endpoints)), on_connect(on_connect), next(0), pending(0), connected(false), timer(io_service) {}
+            std::pair<std::string, unsigned short> host_port;
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+            std::function<void(boost::asio::ip::tcp::socket&&)> on_connect;
+            size_t next;
+            size_t pending;
+            bool connected;
+            boost::asio::deadline_timer timer;
+            std::vector<std::shared_ptr<boost::asio::ip::tcp::socket> > sockets;
+        };
+        
+        ///Happy eyeballs (RFC 8305): attempts are started connect_attempt_delay apart, or as soon as
+        ///the previous one fails, and the first socket to connect wins.
+        void connect_endpoints(const std::pair<std::string, unsigned short> &host_port,
+                               const std::vector<boost::asio::ip::tcp::endpoint> &endpoints,
+                               const std::function<void(boost::asio::ip::tcp::socket&&)> &on_connect) {
+            //Alternate address families, keeping the resolver's preferred family first
+            std::vector<boost::asio::ip::tcp::endpoint> first_family, second_family, interleaved;
+            for(auto &endpoint: endpoints) {
+                if(endpoint.protocol()==endpoints.front().protocol())
+                    first_family.emplace_back(endpoint);
+                else
+                    second_family.emplace_back(endpoint);
+            }
+            for(size_t c=0;c<first_family.size() || c<second_family.size();c++) {
+                if(c<first_family.size())
+                    interleaved.emplace_back(first_family[c]);
+                if(c<second_family.size())
+                    interleaved.emplace_back(second_family[c]);
+            }
+            
+            if(interleaved.empty()) {
+                std::lock_guard<std::mutex> lock(socket_mutex);
+                socket=nullptr;
+                throw boost::system::system_error(boost::asio::error::host_not_found);
+            }
+            
+            start_connect_attempt(std::make_shared<ConnectAttempts>(io_service, host_port, std::move(interleaved), on_connect));
+        }
+        
+        void start_connect_attempt(const std::shared_ptr<ConnectAttempts> &attempts) {
+            if(attempts->connected || attempts->next>=attempts->endpoints.size())
+                return;
+            
+            auto attempt_socket=std::make_shared<boost::asio::ip::tcp::socket>(io_service);
+            attempts->sockets.emplace_back(attempt_socket);
+            attempts->pending++;
+            attempt_socket->async_connect(attempts->endpoints[attempts->next++],
+                                          [this, attempts, attempt_socket](const boost::system::error_code &ec) {
+                attempts->pending--;
+                if(attempts->connected)
+                    return;
+                if(!ec) {
+                    attempts->connected=true;
+                    attempts->timer.cancel();
+                    for(auto &other_socket: attempts->sockets) {
+                        if(other_socket!=attempt_socket) {
+                            boost::system::error_code ec;
+                            other_socket->close(ec);
+                        }
+                    }
+                    boost::asio::ip::tcp::no_delay option(true);
+                    attempt_socket->set_option(option);
+                    
+                    std::lock_guard<std::mutex> lock(socket_mutex);
+                    attempts->on_connect(std::move(*attempt_socket));
+                }
+                else if(attempts->next<attempts->endpoints.size()) {
+                    attempts->timer.cancel();
+                    start_connect_attempt(attempts);
+                }
+                else if(attempts->pending==0) {
+                    //Every address failed, so the cached entry is likely stale
+                    ResolverCache::instance().erase(attempts->host_port.first, attempts->host_port.second);
+                    std::lock_guard<std::mutex> lock(socket_mutex);
+                    socket=nullptr;
+                    throw boost::system::system_error(ec);
+                }
+            });
+            
+            if(attempts->next<attempts->endpoints.size()) {
+                attempts->timer.expires_from_now(boost::posix_time::milliseconds(config.connect_attempt_delay));
+                attempts->timer.async_wait([this, attempts](const boost::system::error_code &ec) {
+                    if(!ec)
+                        start_connect_attempt(attempts);
+                });
+            }
+        }
+        
         std::shared_ptr<boost::asio::deadline_timer> get_timeout_timer() {
             if(config.timeout==0)
                 return nullptr;
@@ -393,35 +595,39 @@ namespace SimpleWeb {
     protected:
         void connect() {
             if(!socket || !socket->is_open()) {
-                std::unique_ptr<boost::asio::ip::tcp::resolver::query> query;
-                if(config.proxy_server.empty())
-                    query=std::unique_ptr<boost::asio::ip::tcp::resolver::query>(new boost::asio::ip::tcp::resolver::query(host, std::to_string(port)));
-                else {
-                    auto proxy_host_port=parse_host_port(config.proxy_server, 8080);
-                    query=std::unique_ptr<boost::asio::ip::tcp::resolver::query>(new boost::asio::ip::tcp::resolver::query(proxy_host_port.first, std::to_string(proxy_host_port.second)));
+                connect_tcp([this](HTTP &&tcp_socket) {
+                    socket=std::unique_ptr<HTTP>(new HTTP(std::move(tcp_socket)));
+                });
+            }
+        }
+    };
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    typedef boost::asio::local::stream_protocol::socket UnixStream;
+
+    ///Client connecting to a Unix domain socket at path, or @name for a name in the abstract namespace.
+    ///host is sent in the Host header.
+    template<>
+    class Client<UnixStream> : public ClientBase<UnixStream> {
+    public:
+        Client(const std::string& path, const std::string& host="localhost") : ClientBase<UnixStream>::ClientBase(host, 80) {
+            if(!path.empty() && path[0]=='@')
+                endpoint=boost::asio::local::stream_protocol::endpoint(std::string(1, '\0')+path.substr(1));
+            else
+                endpoint=boost::asio::local::stream_protocol::endpoint(path);
+        }
+
+    protected:
+        boost::asio::local::stream_protocol::endpoint endpoint;
+
+        void connect() {
+            if(!socket || !socket->is_open()) {
+                {
+                    std::lock_guard<std::mutex> lock(socket_mutex);
+                    socket=std::unique_ptr<UnixStream>(new UnixStream(io_service));
                 }
-                resolver.async_resolve(*query, [this](const boost::system::error_code &ec,
-                                                     boost::asio::ip::tcp::resolver::iterator it){
-                    if(!ec) {
-                        {
-                            std::lock_guard<std::mutex> lock(socket_mutex);
-                            socket=std::unique_ptr<HTTP>(new HTTP(io_service));
-                        }
-                        
-                        boost::asio::async_connect(*socket, it, [this]
-                                (const boost::system::error_code &ec, boost::asio::ip::tcp::resolver::iterator /*it*/){
-                            if(!ec) {
-                                boost::asio::ip::tcp::no_delay option(true);
-                                this->socket->set_option(option);
-                            }
-                            else {
-                                std::lock_guard<std::mutex> lock(socket_mutex);
-                                this->socket=nullptr;
-                                throw boost::system::system_error(ec);
-                            }
-                        });
-                    }
-                    else {
+                socket->async_connect(endpoint, [this](const boost::system::error_code &ec) {
+                    if(ec) {
                         std::lock_guard<std::mutex> lock(socket_mutex);
                         socket=nullptr;
                         throw boost::system::system_error(ec);
@@ -432,6 +638,7 @@ namespace SimpleWeb {
             }
         }
     };
+#endif
 }
 
 #endif	/* CLIENT_HTTP_HPP */
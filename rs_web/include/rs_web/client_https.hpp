@@ -0,0 +1,150 @@
+#ifndef CLIENT_HTTPS_HPP
+#define	CLIENT_HTTPS_HPP
+
+#include <rs_web/client_http.hpp>
+
+#include <boost/asio/ssl.hpp>
+#include <openssl/ssl.h>
+
+#include <memory>
+#include <string>
+
+namespace SimpleWeb {
+    typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> HTTPS;
+
+    ///HTTPS client. The session of the last connection is offered when reconnecting, so that the server can resume it
+    ///instead of performing a full handshake. Through a proxy server, the connection is tunneled with CONNECT.
+    template<>
+    class Client<HTTPS> : public ClientBase<HTTPS> {
+    public:
+        Client(const std::string& server_port_path, bool verify_certificate=true,
+               const std::string& cert_file=std::string(), const std::string& private_key_file=std::string(),
+               const std::string& verify_file=std::string()) :
+                ClientBase<HTTPS>::ClientBase(server_port_path, 443), context(boost::asio::ssl::context::tls_client) {
+            context.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+                                boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_tlsv1 |
+                                boost::asio::ssl::context::no_tlsv1_1);
+            if(!cert_file.empty() && !private_key_file.empty()) {
+                context.use_certificate_chain_file(cert_file);
+                context.use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+            }
+
+            if(verify_certificate)
+                context.set_verify_callback(boost::asio::ssl::rfc2818_verification(host));
+
+            if(!verify_file.empty())
+                context.load_verify_file(verify_file);
+            else
+                context.set_default_verify_paths();
+
+            if(!verify_file.empty() || verify_certificate)
+                context.set_verify_mode(boost::asio::ssl::verify_peer);
+            else
+                context.set_verify_mode(boost::asio::ssl::verify_none);
+
+            //Sessions are taken from the new session callback, since TLS 1.3 tickets arrive after the handshake
+            auto ssl_context=context.native_handle();
+            SSL_CTX_set_session_cache_mode(ssl_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_set_ex_data(ssl_context, client_index(), this);
+            SSL_CTX_sess_set_new_cb(ssl_context, new_session);
+
+            static const unsigned char alpn_protocols[]={8, 'h', 't', 't', 'p', '/', '1', '.', '1'};
+            SSL_CTX_set_alpn_protos(ssl_context, alpn_protocols, sizeof(alpn_protocols));
+        }
+
+        ///Returns true if the current connection resumed an earlier session
+        bool session_reused() {
+            std::lock_guard<std::mutex> lock(socket_mutex);
+            return socket && SSL_session_reused(socket->native_handle());
+        }
+
+    protected:
+        boost::asio::ssl::context context;
+        std::shared_ptr<SSL_SESSION> session;
+
+        void connect() {
+            if(!socket || !socket->lowest_layer().is_open()) {
+                connect_tcp([this](boost::asio::ip::tcp::socket &&tcp_socket) {
+                    //Freeing a connection that was not shut down would make its session unusable for resumption
+                    if(socket)
+                        SSL_set_shutdown(socket->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+                    socket=std::unique_ptr<HTTPS>(new HTTPS(std::move(tcp_socket), context));
+                });
+
+                if(!config.proxy_server.empty())
+                    connect_tunnel();
+
+                SSL_set_tlsext_host_name(socket->native_handle(), host.c_str());
+                if(session)
+                    SSL_set_session(socket->native_handle(), session.get());
+
+                auto timer=get_timeout_timer();
+                socket->async_handshake(boost::asio::ssl::stream_base::client, [this, timer](const boost::system::error_code &ec) {
+                    if(timer)
+                        timer->cancel();
+                    if(ec) {
+                        std::lock_guard<std::mutex> lock(socket_mutex);
+                        socket=nullptr;
+                        throw boost::system::system_error(ec);
+                    }
+                });
+                io_service.reset();
+                io_service.run();
+            }
+        }
+
+        ///Asks the proxy server to open a tunnel to host:port
+        void connect_tunnel() {
+            auto host_port=host+':'+std::to_string(port);
+            boost::asio::streambuf write_buffer;
+            std::ostream write_stream(&write_buffer);
+            write_stream << "CONNECT " << host_port << " HTTP/1.1\r\nHost: " << host_port << "\r\n\r\n";
+            boost::asio::streambuf read_buffer;
+
+            auto timer=get_timeout_timer();
+            boost::asio::async_write(socket->next_layer(), write_buffer, [this, timer, &read_buffer](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                if(ec) {
+                    if(timer)
+                        timer->cancel();
+                    std::lock_guard<std::mutex> lock(socket_mutex);
+                    socket=nullptr;
+                    throw boost::system::system_error(ec);
+                }
+                boost::asio::async_read_until(socket->next_layer(), read_buffer, "\r\n\r\n", [this, timer](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                    if(timer)
+                        timer->cancel();
+                    if(ec) {
+                        std::lock_guard<std::mutex> lock(socket_mutex);
+                        socket=nullptr;
+                        throw boost::system::system_error(ec);
+                    }
+                });
+            });
+            io_service.reset();
+            io_service.run();
+
+            std::istream read_stream(&read_buffer);
+            std::string http_version, status_code;
+            read_stream >> http_version >> status_code;
+            if(status_code!="200") {
+                std::lock_guard<std::mutex> lock(socket_mutex);
+                socket=nullptr;
+                throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::connection_refused));
+            }
+        }
+
+        ///Index of the Client in the ex_data of its SSL context (the app_data is used by asio's verify callback)
+        static int client_index() {
+            static const int index=SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+            return index;
+        }
+
+        static int new_session(SSL *ssl, SSL_SESSION *new_session) {
+            auto client=static_cast<Client<HTTPS>*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), client_index()));
+            client->session=std::shared_ptr<SSL_SESSION>(new_session, SSL_SESSION_free);
+            return 1;
+        }
+    };
+}
+
+#endif	/* CLIENT_HTTPS_HPP */
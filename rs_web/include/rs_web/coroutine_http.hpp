@@ -0,0 +1,319 @@
+#ifndef COROUTINE_HTTP_HPP
+#define	COROUTINE_HTTP_HPP
+
+#ifndef __cpp_impl_coroutine
+#error "coroutine_http.hpp requires C++20 coroutines (configure with -DRS_WEB_COROUTINES=ON)"
+#endif
+
+#include <rs_web/server_http.hpp>
+#include <rs_web/async_client_http.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+namespace SimpleWeb {
+    ///Recycles coroutine frames through per-thread free lists, so that coroutine resource functions
+    ///do not allocate from the heap once the reactor threads have warmed up.
+    class FramePool {
+    public:
+        static void* allocate(size_t size) {
+            auto size_class=(size+granularity-1)/granularity;
+            if(size_class>=num_size_classes)
+                return ::operator new(size);
+            auto &free_list=free_lists()[size_class];
+            if(!free_list.empty()) {
+                auto block=free_list.back();
+                free_list.pop_back();
+                return block;
+            }
+            return ::operator new(size_class*granularity);
+        }
+
+        static void deallocate(void *block, size_t size) {
+            auto size_class=(size+granularity-1)/granularity;
+            if(size_class<num_size_classes) {
+                auto &free_list=free_lists()[size_class];
+                if(free_list.size()<max_free_blocks) {
+                    free_list.emplace_back(block);
+                    return;
+                }
+            }
+            ::operator delete(block);
+        }
+
+    private:
+        static constexpr size_t granularity=64;
+        static constexpr size_t num_size_classes=64;
+        static constexpr size_t max_free_blocks=256;
+
+        class FreeLists {
+        public:
+            std::vector<void*> lists[num_size_classes];
+            ~FreeLists() {
+                for(auto &list: lists) {
+                    for(auto block: list)
+                        ::operator delete(block);
+                }
+            }
+            std::vector<void*> &operator[](size_t size_class) {
+                return lists[size_class];
+            }
+        };
+
+        static FreeLists &free_lists() {
+            thread_local FreeLists lists;
+            return lists;
+        }
+    };
+
+    ///Return type of coroutine resource functions. The coroutine starts when the request arrives, and the
+    ///response is sent once the coroutine has finished and released its Response.
+    class Task {
+    public:
+        class promise_type {
+            friend class Task;
+            std::function<void(const std::exception&)> exception_handler;
+        public:
+            Task get_return_object() {
+                return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() {
+                try {
+                    throw;
+                }
+                catch(const std::exception &e) {
+                    if(exception_handler)
+                        exception_handler(e);
+                }
+                catch(...) {}
+            }
+
+            static void* operator new(size_t size) {
+                return FramePool::allocate(size);
+            }
+            static void operator delete(void *block, size_t size) {
+                FramePool::deallocate(block, size);
+            }
+        };
+
+        Task(Task &&other) noexcept: handle(other.handle) {
+            other.handle=nullptr;
+        }
+        Task(const Task&)=delete;
+        Task &operator=(const Task&)=delete;
+        ~Task() {
+            if(handle)
+                handle.destroy();
+        }
+
+        ///Runs the coroutine until its first suspension. Afterwards the coroutine owns itself.
+        void start(const std::function<void(const std::exception&)> &exception_handler) {
+            auto started=handle;
+            handle=nullptr;
+            started.promise().exception_handler=exception_handler;
+            started.resume();
+        }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle): handle(handle) {}
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    ///Adapts a coroutine resource function, taking the same parameters as a regular resource function and
+    ///returning Task, so that it can be stored in ServerBase::resource or ServerBase::default_resource.
+    template<class socket_type, class Function>
+    std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>, std::shared_ptr<typename ServerBase<socket_type>::Request>)>
+    coroutine_resource(ServerBase<socket_type> &server, Function function) {
+        return [&server, function](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                   std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+            Task task=function(std::move(response), std::move(request));
+            task.start(server.exception_handler);
+        };
+    }
+
+    ///co_await async_send(server, response) writes what has been written to response so far, and resumes once
+    ///the data is on the socket. Returns the error code of the write.
+    template<class socket_type>
+    class SendAwaiter {
+    public:
+        SendAwaiter(const ServerBase<socket_type> &server, const std::shared_ptr<typename ServerBase<socket_type>::Response> &response) :
+                server(server), response(response) {}
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            server.send(response, [this, handle](const boost::system::error_code &ec) {
+                this->ec=ec;
+                handle.resume();
+            });
+        }
+        boost::system::error_code await_resume() const noexcept {
+            return ec;
+        }
+    private:
+        const ServerBase<socket_type> &server;
+        std::shared_ptr<typename ServerBase<socket_type>::Response> response;
+        boost::system::error_code ec;
+    };
+
+    template<class socket_type>
+    SendAwaiter<socket_type> async_send(const ServerBase<socket_type> &server, const std::shared_ptr<typename ServerBase<socket_type>::Response> &response) {
+        return SendAwaiter<socket_type>(server, response);
+    }
+
+    ///co_await async_sleep(io_service, duration) resumes on io_service after duration.
+    class SleepAwaiter {
+    public:
+        SleepAwaiter(boost::asio::io_service &io_service, std::chrono::steady_clock::duration duration) :
+                timer(io_service), duration(duration) {}
+        bool await_ready() const noexcept {
+            return duration<=std::chrono::steady_clock::duration::zero();
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            timer.expires_from_now(duration);
+            timer.async_wait([this, handle](const boost::system::error_code &ec) {
+                this->ec=ec;
+                handle.resume();
+            });
+        }
+        boost::system::error_code await_resume() const noexcept {
+            return ec;
+        }
+    private:
+        boost::asio::steady_timer timer;
+        std::chrono::steady_clock::duration duration;
+        boost::system::error_code ec;
+    };
+
+    inline SleepAwaiter async_sleep(boost::asio::io_service &io_service, std::chrono::steady_clock::duration duration) {
+        return SleepAwaiter(io_service, duration);
+    }
+
+    ///Threads for blocking work that must not run on the reactor threads.
+    class WorkerPool {
+    public:
+        explicit WorkerPool(size_t num_threads): work(new boost::asio::io_service::work(io_service)) {
+            for(size_t c=0;c<num_threads;c++) {
+                threads.emplace_back([this] {
+                    io_service.run();
+                });
+            }
+        }
+        ~WorkerPool() {
+            work.reset();
+            for(auto &thread: threads)
+                thread.join();
+        }
+
+        template<class Function>
+        void post(Function &&function) {
+            io_service.post(std::forward<Function>(function));
+        }
+
+    private:
+        boost::asio::io_service io_service;
+        std::unique_ptr<boost::asio::io_service::work> work;
+        std::vector<std::thread> threads;
+    };
+
+    ///co_await offload(pool, io_service, function) runs function on the worker pool and resumes on io_service
+    ///with its result. Exceptions thrown by function are rethrown in the coroutine.
+    template<class Function>
+    class OffloadAwaiter {
+        typedef decltype(std::declval<Function&>()()) result_type;
+        typedef typename std::conditional<std::is_void<result_type>::value, std::monostate, result_type>::type stored_type;
+    public:
+        OffloadAwaiter(WorkerPool &pool, boost::asio::io_service &io_service, Function function) :
+                pool(pool), io_service(io_service), function(std::move(function)) {}
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            pool.post([this, handle] {
+                try {
+                    if constexpr(std::is_void<result_type>::value) {
+                        function();
+                        result.emplace();
+                    }
+                    else
+                        result.emplace(function());
+                }
+                catch(...) {
+                    exception=std::current_exception();
+                }
+                io_service.post([handle] {
+                    handle.resume();
+                });
+            });
+        }
+        result_type await_resume() {
+            if(exception)
+                std::rethrow_exception(exception);
+            if constexpr(!std::is_void<result_type>::value)
+                return std::move(*result);
+        }
+    private:
+        WorkerPool &pool;
+        boost::asio::io_service &io_service;
+        Function function;
+        std::optional<stored_type> result;
+        std::exception_ptr exception;
+    };
+
+    template<class Function>
+    OffloadAwaiter<typename std::decay<Function>::type> offload(WorkerPool &pool, boost::asio::io_service &io_service, Function &&function) {
+        return OffloadAwaiter<typename std::decay<Function>::type>(pool, io_service, std::forward<Function>(function));
+    }
+
+    ///co_await async_request(client, ...) resumes with the error code and response of AsyncClient::request.
+    class RequestAwaiter {
+    public:
+        RequestAwaiter(AsyncClient &client, const std::string &request_type, const std::string &path, const std::string &content,
+                       const std::map<std::string, std::string> &header) :
+                client(client), request_type(request_type), path(path), content(content), header(header) {}
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            client.request(request_type, path, content, header,
+                           [this, handle](const boost::system::error_code &ec, std::shared_ptr<AsyncClient::Response> response) {
+                this->ec=ec;
+                this->response=std::move(response);
+                handle.resume();
+            });
+        }
+        std::pair<boost::system::error_code, std::shared_ptr<AsyncClient::Response> > await_resume() {
+            return std::make_pair(ec, std::move(response));
+        }
+    private:
+        AsyncClient &client;
+        std::string request_type, path, content;
+        std::map<std::string, std::string> header;
+        boost::system::error_code ec;
+        std::shared_ptr<AsyncClient::Response> response;
+    };
+
+    inline RequestAwaiter async_request(AsyncClient &client, const std::string &request_type, const std::string &path="/",
+                                        const std::string &content="", const std::map<std::string, std::string> &header=std::map<std::string, std::string>()) {
+        return RequestAwaiter(client, request_type, path, content, header);
+    }
+}
+
+#endif	/* COROUTINE_HTTP_HPP */
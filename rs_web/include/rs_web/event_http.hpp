@@ -0,0 +1,297 @@
+#ifndef EVENT_HTTP_HPP
+#define	EVENT_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <condition_variable>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace SimpleWeb {
+    ///Publish/subscribe hub serving Server-Sent Events (text/event-stream) on GET /events/<channel>.
+    ///A published event is encoded once into an immutable buffer, which is queued by reference to every subscriber of
+    ///its channel and written to the connections with gather writes. Each subscriber has a bounded queue, so that a slow
+    ///client loses events instead of holding memory, and the last events of each channel are kept so that reconnecting
+    ///clients get what they missed, from the Last-Event-ID that EventSource sends.
+    ///
+    ///Connections served through HTTP/2 get the events kept so far and are then closed, after which EventSource reconnects.
+    template<class socket_type>
+    class EventHub {
+    public:
+        ///What happens to a subscriber's queue when a new event arrives while it is behind
+        enum class Policy {
+            ///The oldest queued event is dropped when the queue is full
+            drop_oldest,
+            ///A queued event of the same type is replaced, for channels where only the latest state matters
+            coalesce
+        };
+
+        class Config {
+            friend class EventHub<socket_type>;
+
+            Config(): max_queue(64), replay(256), heartbeat(15), retry(3000) {}
+        public:
+            /// Events queued per subscriber.
+            size_t max_queue;
+            /// Events kept per channel for clients reconnecting with Last-Event-ID.
+            size_t replay;
+            /// Seconds between comments sent to idle subscribers, to keep proxies from closing the connections, and to
+            /// find subscribers that are gone. 0 disables them.
+            size_t heartbeat;
+            /// Milliseconds EventSource waits before reconnecting.
+            size_t retry;
+        };
+        /// Set before calling attach().
+        Config config;
+
+        EventHub(const ServerBase<socket_type> &server): server(server), running(true) {}
+
+        ///Destroy after the server has stopped
+        ~EventHub() {
+            {
+                std::lock_guard<std::mutex> lock(heartbeat_mutex);
+                running=false;
+            }
+            heartbeat_condition.notify_all();
+            if(heartbeat_thread.joinable())
+                heartbeat_thread.join();
+        }
+
+        ///Adds a channel. Call before attach().
+        void add_channel(const std::string &name, Policy policy=Policy::drop_oldest) {
+            channels.emplace(name, std::unique_ptr<Channel>(new Channel(policy)));
+        }
+
+        ///Adds GET /events/<channel> to server, and starts the heartbeats. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.resource["^/events/([A-Za-z0-9_.-]+)(\\?.*)?$"]["GET"]=[this](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                                std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                subscribe(response, request);
+            };
+            if(config.heartbeat>0 && !heartbeat_thread.joinable()) {
+                heartbeat_thread=std::thread([this] {
+                    std::unique_lock<std::mutex> lock(heartbeat_mutex);
+                    while(!heartbeat_condition.wait_for(lock, std::chrono::seconds(config.heartbeat), [this] {
+                        return !running;
+                    })) {
+                        lock.unlock();
+                        heartbeat();
+                        lock.lock();
+                    }
+                });
+            }
+        }
+
+        ///Sends an event of type with data, which may span several lines, to the subscribers of channel.
+        ///Can be called from any thread. Returns the id of the event, or 0 if there is no such channel.
+        unsigned long long publish(const std::string &channel_name, const std::string &type, const std::string &data) {
+            auto it=channels.find(channel_name);
+            if(it==channels.end())
+                return 0;
+            auto &channel=*it->second;
+            std::lock_guard<std::mutex> lock(channel.mutex);
+            auto id=++channel.last_id;
+            auto event=std::make_shared<Event>(id, type, Event::format(id, type, data));
+            channel.recent.emplace_back(event);
+            if(channel.recent.size()>config.replay)
+                channel.recent.erase(channel.recent.begin(), channel.recent.begin()+static_cast<std::ptrdiff_t>(channel.recent.size()-config.replay));
+            for(auto &subscriber: channel.subscribers)
+                enqueue(channel, subscriber, event);
+            return event->id;
+        }
+
+        ///Number of subscribers of channel
+        size_t subscribers(const std::string &channel_name) {
+            auto it=channels.find(channel_name);
+            if(it==channels.end())
+                return 0;
+            std::lock_guard<std::mutex> lock(it->second->mutex);
+            return it->second->subscribers.size();
+        }
+
+    private:
+        ///An event encoded as an HTTP/1.1 chunk, whose payload is also the event as written without chunked encoding
+        class Event {
+        public:
+            Event(unsigned long long id, const std::string &type, const std::string &payload) :
+                    id(id), type(type), encoded(chunk(payload)), payload_offset(encoded.find("\r\n")+2), payload_size(payload.size()) {}
+
+            unsigned long long id;
+            std::string type;
+            std::string encoded;
+            size_t payload_offset, payload_size;
+
+            boost::asio::const_buffer buffer(bool chunked) const {
+                if(chunked)
+                    return boost::asio::buffer(encoded);
+                return boost::asio::buffer(encoded.data()+payload_offset, payload_size);
+            }
+
+            ///The event in the text/event-stream format
+            static std::string format(unsigned long long id, const std::string &type, const std::string &data) {
+                std::string payload="id: "+std::to_string(id)+'\n';
+                if(!type.empty())
+                    payload+="event: "+type+'\n';
+                size_t line_start=0;
+                do {
+                    auto line_end=data.find('\n', line_start);
+                    if(line_end==std::string::npos)
+                        line_end=data.size();
+                    payload+="data: ";
+                    payload.append(data, line_start, line_end-line_start);
+                    payload+='\n';
+                    line_start=line_end+1;
+                } while(line_start<=data.size());
+                payload+='\n';
+                return payload;
+            }
+
+            static std::string chunk(const std::string &payload) {
+                char size[20];
+                std::snprintf(size, sizeof(size), "%zx\r\n", payload.size());
+                return size+payload+"\r\n";
+            }
+        };
+
+        class Subscriber {
+        public:
+            Subscriber(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response, bool chunked) :
+                    response(response), chunked(chunked), busy(false) {}
+            std::shared_ptr<typename ServerBase<socket_type>::Response> response;
+            bool chunked;
+            ///A write is in progress
+            bool busy;
+            std::vector<std::shared_ptr<const Event> > queue;
+            typename std::list<std::shared_ptr<Subscriber> >::iterator position;
+        };
+
+        class Channel {
+        public:
+            Channel(Policy policy): policy(policy), last_id(0) {}
+            Policy policy;
+            std::mutex mutex;
+            unsigned long long last_id;
+            std::vector<std::shared_ptr<const Event> > recent;
+            std::list<std::shared_ptr<Subscriber> > subscribers;
+        };
+
+        const ServerBase<socket_type> &server;
+        std::unordered_map<std::string, std::unique_ptr<Channel> > channels;
+
+        std::mutex heartbeat_mutex;
+        std::condition_variable heartbeat_condition;
+        bool running;
+        std::thread heartbeat_thread;
+
+        void subscribe(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response,
+                       const std::shared_ptr<typename ServerBase<socket_type>::Request> &request) {
+            auto it=channels.find(request->path_match[1]);
+            if(it==channels.end()) {
+                *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                return;
+            }
+            auto &channel=*it->second;
+
+            unsigned long long last_event_id=0;
+            auto header_it=request->header.find("Last-Event-ID");
+            if(header_it!=request->header.end()) {
+                try {
+                    last_event_id=std::stoull(header_it->second);
+                }
+                catch(const std::exception &) {}
+            }
+
+            auto retry="retry: "+std::to_string(config.retry)+"\n\n";
+            if(!server.keep_open(response, request)) {
+                //Without a connection of its own, the response ends with the events kept so far
+                std::lock_guard<std::mutex> lock(channel.mutex);
+                std::string content=retry;
+                for(auto &event: channel.recent) {
+                    if(event->id>last_event_id)
+                        content.append(event->encoded, event->payload_offset, event->payload_size);
+                }
+                *response << "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nContent-Length: "
+                          << content.size() << "\r\n\r\n" << content;
+                return;
+            }
+
+            //HTTP/1.1 streams are chunked, so that the connection can be reused once the stream ends
+            bool chunked=request->http_version!="1.0";
+            *response << "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                      << (chunked?"Transfer-Encoding: chunked\r\n":"Connection: close\r\n") << "\r\n"
+                      << (chunked?Event::chunk(retry):retry);
+
+            auto subscriber=std::make_shared<Subscriber>(response, chunked);
+            std::lock_guard<std::mutex> lock(channel.mutex);
+            subscriber->position=channel.subscribers.emplace(channel.subscribers.end(), subscriber);
+            if(last_event_id>0) {
+                for(auto &event: channel.recent) {
+                    if(event->id>last_event_id)
+                        subscriber->queue.emplace_back(event);
+                }
+                if(subscriber->queue.size()>config.max_queue)
+                    subscriber->queue.erase(subscriber->queue.begin(), subscriber->queue.begin()+static_cast<std::ptrdiff_t>(subscriber->queue.size()-config.max_queue));
+            }
+            write(channel, subscriber);
+        }
+
+        ///Called with channel.mutex locked
+        void enqueue(Channel &channel, const std::shared_ptr<Subscriber> &subscriber, const std::shared_ptr<const Event> &event) {
+            auto &queue=subscriber->queue;
+            if(channel.policy==Policy::coalesce) {
+                for(auto it=queue.begin();it!=queue.end();it++) {
+                    if((*it)->type==event->type) {
+                        queue.erase(it);
+                        break;
+                    }
+                }
+            }
+            if(queue.size()>=config.max_queue && !queue.empty())
+                queue.erase(queue.begin());
+            queue.emplace_back(event);
+            if(!subscriber->busy)
+                write(channel, subscriber);
+        }
+
+        ///Writes what is buffered in the response and the queued events at once. Called with channel.mutex locked.
+        void write(Channel &channel, const std::shared_ptr<Subscriber> &subscriber) {
+            subscriber->busy=true;
+            for(auto &event: subscriber->queue)
+                subscriber->response->write(event->buffer(subscriber->chunked), event);
+            subscriber->queue.clear();
+            server.send(subscriber->response, [this, &channel, subscriber](const boost::system::error_code &ec) {
+                std::lock_guard<std::mutex> lock(channel.mutex);
+                subscriber->busy=false;
+                if(ec) {
+                    //The client is gone; releasing the response ends the connection
+                    channel.subscribers.erase(subscriber->position);
+                    subscriber->response=nullptr;
+                }
+                else if(!subscriber->queue.empty())
+                    write(channel, subscriber);
+            });
+        }
+
+        void heartbeat() {
+            //A comment line, ignored by EventSource
+            static const std::shared_ptr<const Event> comment=std::make_shared<Event>(0, std::string(), ":\n\n");
+            for(auto &channel: channels) {
+                std::lock_guard<std::mutex> lock(channel.second->mutex);
+                for(auto &subscriber: channel.second->subscribers) {
+                    if(!subscriber->busy && subscriber->queue.empty()) {
+                        subscriber->queue.emplace_back(comment);
+                        write(*channel.second, subscriber);
+                    }
+                }
+            }
+        }
+    };
+}
+
+#endif	/* EVENT_HTTP_HPP */
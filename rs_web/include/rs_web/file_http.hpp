@@ -0,0 +1,345 @@
+#ifndef FILE_HTTP_HPP
+#define	FILE_HTTP_HPP
+
+#include <boost/asio.hpp>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+//IORING_FEAT_RW_CUR_POS first appeared in the Linux 5.6 headers, which also added openat, read and probing
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define SIMPLE_WEB_IO_URING
+#endif
+#endif
+#endif
+
+namespace SimpleWeb {
+    ///Opens and reads files without blocking the io_service threads. Requests are submitted to io_uring where the
+    ///kernel supports it, and otherwise to a small pool of threads. Callbacks are always run through the io_service.
+    class FileService {
+    public:
+        class File {
+            friend class FileService;
+        public:
+            ~File() {
+                if(fd>=0)
+                    ::close(fd);
+            }
+            uint64_t size() const {
+                return file_size;
+            }
+            bool is_directory() const {
+                return directory;
+            }
+            ///Absolute path of the opened file, with symbolic links resolved, or an empty string if it cannot be found.
+            ///Unlike resolving the requested path, this names the file that was actually opened.
+            std::string real_path() const {
+                char buffer[PATH_MAX];
+                auto length=::readlink(("/proc/self/fd/"+std::to_string(fd)).c_str(), buffer, sizeof(buffer));
+                if(length<=0 || static_cast<size_t>(length)>=sizeof(buffer))
+                    return std::string();
+                return std::string(buffer, static_cast<size_t>(length));
+            }
+        private:
+            File(int fd): fd(fd), file_size(0), directory(false) {}
+            int fd;
+            uint64_t file_size;
+            bool directory;
+        };
+
+        typedef std::function<void(const boost::system::error_code&, std::shared_ptr<File>)> open_callback;
+        typedef std::function<void(const boost::system::error_code&, size_t)> read_callback;
+
+        FileService(boost::asio::io_service &io_service, size_t num_threads=2, unsigned queue_depth=256) :
+                io_service(io_service), worker_work(new boost::asio::io_service::work(worker_io_service)) {
+#ifdef SIMPLE_WEB_IO_URING
+            ring=std::unique_ptr<Ring>(new Ring(io_service));
+            if(!ring->init(queue_depth))
+                ring=nullptr;
+#else
+            (void)queue_depth;
+#endif
+            for(size_t c=0;c<num_threads;c++) {
+                threads.emplace_back([this] {
+                    worker_io_service.run();
+                });
+            }
+        }
+
+        ~FileService() {
+            worker_work.reset();
+            worker_io_service.stop();
+            for(auto &thread: threads)
+                thread.join();
+        }
+
+        bool uses_io_uring() const {
+#ifdef SIMPLE_WEB_IO_URING
+            return ring!=nullptr;
+#else
+            return false;
+#endif
+        }
+
+        ///Opens path for reading. The callback receives the opened file, with its size and whether it is a directory.
+        void async_open(const std::string &path, const open_callback &callback) {
+            auto finish=[this, callback](int result) {
+                if(result<0) {
+                    callback(boost::system::error_code(-result, boost::system::system_category()), nullptr);
+                    return;
+                }
+                std::shared_ptr<File> file(new File(result));
+                //The inode is in memory once open has completed, so fstat does not wait for the disk
+                struct stat file_stat;
+                if(fstat(file->fd, &file_stat)!=0) {
+                    callback(boost::system::error_code(errno, boost::system::system_category()), nullptr);
+                    return;
+                }
+                file->file_size=static_cast<uint64_t>(file_stat.st_size);
+                file->directory=S_ISDIR(file_stat.st_mode);
+                callback(boost::system::error_code(), file);
+            };
+#ifdef SIMPLE_WEB_IO_URING
+            if(ring && ring->submit_open(path, finish))
+                return;
+#endif
+            auto path_copy=path;
+            worker_io_service.post([this, path_copy, finish] {
+                int result=::open(path_copy.c_str(), O_RDONLY|O_CLOEXEC);
+                if(result<0)
+                    result=-errno;
+                io_service.post([finish, result] {
+                    finish(result);
+                });
+            });
+        }
+
+        ///Reads up to size bytes at offset into buffer, which must stay valid until the callback is called.
+        ///A read at or beyond the end of the file completes with 0 bytes.
+        void async_read(const std::shared_ptr<File> &file, uint64_t offset, char *buffer, size_t size, const read_callback &callback) {
+            auto finish=[file, callback](int result) {
+                if(result<0)
+                    callback(boost::system::error_code(-result, boost::system::system_category()), 0);
+                else
+                    callback(boost::system::error_code(), static_cast<size_t>(result));
+            };
+#ifdef SIMPLE_WEB_IO_URING
+            if(ring && ring->submit_read(file->fd, offset, buffer, size, finish))
+                return;
+#endif
+            worker_io_service.post([this, file, offset, buffer, size, finish] {
+                auto result=static_cast<int>(::pread(file->fd, buffer, size, static_cast<off_t>(offset)));
+                if(result<0)
+                    result=-errno;
+                io_service.post([finish, result] {
+                    finish(result);
+                });
+            });
+        }
+
+    private:
+        boost::asio::io_service &io_service;
+        boost::asio::io_service worker_io_service;
+        std::unique_ptr<boost::asio::io_service::work> worker_work;
+        std::vector<std::thread> threads;
+
+#ifdef SIMPLE_WEB_IO_URING
+        ///Minimal io_uring submission and completion queues. Completions are signalled through an eventfd
+        ///that is read by the io_service, so callbacks run on the io_service threads like other handlers.
+        class Ring {
+        public:
+            Ring(boost::asio::io_service &io_service): ring_fd(-1), event_fd(-1), event_descriptor(io_service),
+                    sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sqes(MAP_FAILED), sq_ring_size(0), cq_ring_size(0), sqes_size(0) {}
+
+            ~Ring() {
+                boost::system::error_code ec;
+                event_descriptor.close(ec);
+                if(sqes!=MAP_FAILED)
+                    munmap(sqes, sqes_size);
+                if(cq_ring!=MAP_FAILED && cq_ring!=sq_ring)
+                    munmap(cq_ring, cq_ring_size);
+                if(sq_ring!=MAP_FAILED)
+                    munmap(sq_ring, sq_ring_size);
+                if(ring_fd>=0)
+                    ::close(ring_fd);
+            }
+
+            bool init(unsigned entries) {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                ring_fd=static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                if(ring_fd<0)
+                    return false;
+
+                //openat and read were added in Linux 5.6
+                std::vector<char> probe_buffer(sizeof(io_uring_probe)+256*sizeof(io_uring_probe_op), 0);
+                auto probe=reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+                if(syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256)<0)
+                    return false;
+                for(unsigned op: {static_cast<unsigned>(IORING_OP_OPENAT), static_cast<unsigned>(IORING_OP_READ)}) {
+                    if(op>=probe->ops_len || !(probe->ops[op].flags&IO_URING_OP_SUPPORTED))
+                        return false;
+                }
+
+                sq_ring_size=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+                cq_ring_size=params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+                bool single_mmap=(params.features&IORING_FEAT_SINGLE_MMAP)!=0;
+                if(single_mmap)
+                    sq_ring_size=cq_ring_size=std::max(sq_ring_size, cq_ring_size);
+                sq_ring=mmap(nullptr, sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+                if(sq_ring==MAP_FAILED)
+                    return false;
+                if(single_mmap)
+                    cq_ring=sq_ring;
+                else {
+                    cq_ring=mmap(nullptr, cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+                    if(cq_ring==MAP_FAILED)
+                        return false;
+                }
+                sqes_size=params.sq_entries*sizeof(io_uring_sqe);
+                sqes=mmap(nullptr, sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+                if(sqes==MAP_FAILED)
+                    return false;
+
+                auto sq=static_cast<char*>(sq_ring);
+                sq_head=reinterpret_cast<unsigned*>(sq+params.sq_off.head);
+                sq_tail=reinterpret_cast<unsigned*>(sq+params.sq_off.tail);
+                sq_mask=*reinterpret_cast<unsigned*>(sq+params.sq_off.ring_mask);
+                sq_entries=params.sq_entries;
+                sq_array=reinterpret_cast<unsigned*>(sq+params.sq_off.array);
+                auto cq=static_cast<char*>(cq_ring);
+                cq_head=reinterpret_cast<unsigned*>(cq+params.cq_off.head);
+                cq_tail=reinterpret_cast<unsigned*>(cq+params.cq_off.tail);
+                cq_mask=*reinterpret_cast<unsigned*>(cq+params.cq_off.ring_mask);
+                cqes=reinterpret_cast<io_uring_cqe*>(cq+params.cq_off.cqes);
+
+                event_fd=eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+                if(event_fd<0)
+                    return false;
+                if(syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1)<0) {
+                    ::close(event_fd);
+                    return false;
+                }
+                event_descriptor.assign(event_fd);
+                wait_for_completions();
+                return true;
+            }
+
+            bool submit_open(const std::string &path, const std::function<void(int)> &callback) {
+                std::unique_ptr<Operation> operation(new Operation(callback));
+                operation->path=path;
+                std::lock_guard<std::mutex> lock(sq_mutex);
+                auto sqe=next_sqe();
+                if(!sqe)
+                    return false;
+                sqe->opcode=IORING_OP_OPENAT;
+                sqe->fd=AT_FDCWD;
+                sqe->addr=reinterpret_cast<uint64_t>(operation->path.c_str());
+                sqe->open_flags=O_RDONLY|O_CLOEXEC;
+                sqe->user_data=reinterpret_cast<uint64_t>(operation.get());
+                return submit(operation);
+            }
+
+            bool submit_read(int fd, uint64_t offset, char *buffer, size_t size, const std::function<void(int)> &callback) {
+                std::unique_ptr<Operation> operation(new Operation(callback));
+                std::lock_guard<std::mutex> lock(sq_mutex);
+                auto sqe=next_sqe();
+                if(!sqe)
+                    return false;
+                sqe->opcode=IORING_OP_READ;
+                sqe->fd=fd;
+                sqe->off=offset;
+                sqe->addr=reinterpret_cast<uint64_t>(buffer);
+                sqe->len=static_cast<unsigned>(size);
+                sqe->user_data=reinterpret_cast<uint64_t>(operation.get());
+                return submit(operation);
+            }
+
+        private:
+            class Operation {
+            public:
+                Operation(const std::function<void(int)> &callback): callback(callback) {}
+                std::function<void(int)> callback;
+                std::string path;
+            };
+
+            int ring_fd;
+            int event_fd;
+            boost::asio::posix::stream_descriptor event_descriptor;
+            uint64_t event_count;
+
+            void *sq_ring, *cq_ring, *sqes;
+            size_t sq_ring_size, cq_ring_size, sqes_size;
+            unsigned *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+            unsigned *cq_head, *cq_tail, cq_mask;
+            io_uring_cqe *cqes;
+            std::mutex sq_mutex;
+
+            ///Called with sq_mutex locked. Returns nullptr when the submission queue is full.
+            io_uring_sqe *next_sqe() {
+                auto tail=*sq_tail;
+                if(tail-__atomic_load_n(sq_head, __ATOMIC_ACQUIRE)>=sq_entries)
+                    return nullptr;
+                auto sqe=&static_cast<io_uring_sqe*>(sqes)[tail&sq_mask];
+                std::memset(sqe, 0, sizeof(*sqe));
+                return sqe;
+            }
+
+            ///Called with sq_mutex locked, after the entry returned by next_sqe() has been filled in
+            bool submit(std::unique_ptr<Operation> &operation) {
+                auto tail=*sq_tail;
+                sq_array[tail&sq_mask]=tail&sq_mask;
+                __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+                if(syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0)<0) {
+                    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+                    return false;
+                }
+                operation.release();
+                return true;
+            }
+
+            void wait_for_completions() {
+                event_descriptor.async_read_some(boost::asio::buffer(&event_count, sizeof(event_count)),
+                                                 [this](const boost::system::error_code &ec, size_t /*bytes_transferred*/) {
+                    if(ec==boost::asio::error::operation_aborted)
+                        return;
+                    std::vector<std::pair<Operation*, int> > completed;
+                    auto head=*cq_head;
+                    auto tail=__atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+                    for(;head!=tail;head++) {
+                        auto &cqe=cqes[head&cq_mask];
+                        completed.emplace_back(reinterpret_cast<Operation*>(cqe.user_data), cqe.res);
+                    }
+                    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+                    wait_for_completions();
+                    for(auto &completion: completed) {
+                        std::unique_ptr<Operation> operation(completion.first);
+                        operation->callback(completion.second);
+                    }
+                });
+            }
+        };
+
+        std::unique_ptr<Ring> ring;
+#endif
+    };
+}
+
+#endif	/* FILE_HTTP_HPP */
@@ -0,0 +1,1251 @@
+#ifndef HTTP2_HTTP_HPP
+#define	HTTP2_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cctype>
+
+namespace SimpleWeb {
+    ///HTTP/2 header compression (RFC 7541)
+    class Hpack {
+    public:
+        typedef std::vector<std::pair<std::string, std::string> > header_list;
+
+        ///Dynamic table, shared by the encoder and decoder side of a connection
+        class Table {
+        public:
+            explicit Table(size_t max_size): max_size(max_size), size(0) {}
+
+            void set_max_size(size_t max_size) {
+                this->max_size=max_size;
+                evict(0);
+            }
+
+            void add(const std::string &name, const std::string &value) {
+                auto entry_size=name.size()+value.size()+32;
+                evict(entry_size);
+                if(entry_size>max_size)
+                    return;
+                entries.emplace_front(name, value);
+                size+=entry_size;
+            }
+
+            ///Returns the entry at index, counting from 1 through the static table into the dynamic table, or nullptr
+            const std::pair<std::string, std::string> *get(size_t index) const {
+                if(index==0)
+                    return nullptr;
+                if(index<=static_table().size())
+                    return &static_table()[index-1];
+                index-=static_table().size()+1;
+                return index<entries.size()?&entries[index]:nullptr;
+            }
+
+            ///Returns the index of the entry matching name and value, or else of the first entry matching name (0 if none)
+            size_t find(const std::string &name, const std::string &value, bool &value_matched) const {
+                size_t name_index=0;
+                value_matched=false;
+                for(size_t c=0;c<static_table().size();c++) {
+                    if(static_table()[c].first==name) {
+                        if(static_table()[c].second==value) {
+                            value_matched=true;
+                            return c+1;
+                        }
+                        if(name_index==0)
+                            name_index=c+1;
+                    }
+                }
+                for(size_t c=0;c<entries.size();c++) {
+                    if(entries[c].first==name) {
+                        if(entries[c].second==value) {
+                            value_matched=true;
+                            return static_table().size()+c+1;
+                        }
+                        if(name_index==0)
+                            name_index=static_table().size()+c+1;
+                    }
+                }
+                return name_index;
+            }
+
+        private:
+            size_t max_size, size;
+            std::deque<std::pair<std::string, std::string> > entries;
+
+            void evict(size_t room) {
+                while(!entries.empty() && size+room>max_size) {
+                    size-=entries.back().first.size()+entries.back().second.size()+32;
+                    entries.pop_back();
+                }
+            }
+        };
+
+        class Decoder {
+        public:
+            explicit Decoder(size_t max_table_size): table(max_table_size), max_table_size(max_table_size) {}
+
+            ///Appends the header fields of a complete header block to headers. Returns false on a compression error,
+            ///after which the connection can no longer be used.
+            ///list_size is set to the size of the decoded fields (RFC 7540, 6.5.2). Past max_list_size, fields are still
+            ///decoded to keep the dynamic table in sync, but no longer appended, since a single byte may repeat a long entry.
+            bool decode(const unsigned char *data, size_t size, size_t max_list_size, header_list &headers, size_t &list_size) {
+                auto end=data+size;
+                list_size=0;
+                while(data!=end) {
+                    auto first=*data;
+                    size_t index;
+                    if(first&0x80) {
+                        if(!decode_integer(data, end, 7, index))
+                            return false;
+                        auto entry=table.get(index);
+                        if(!entry)
+                            return false;
+                        list_size+=entry->first.size()+entry->second.size()+32;
+                        if(list_size<=max_list_size)
+                            headers.emplace_back(*entry);
+                    }
+                    else if((first&0xe0)==0x20) {
+                        size_t new_size;
+                        if(!decode_integer(data, end, 5, new_size) || new_size>max_table_size)
+                            return false;
+                        table.set_max_size(new_size);
+                    }
+                    else {
+                        //Literal with incremental indexing (01), without indexing (0000) or never indexed (0001)
+                        bool indexing=(first&0xc0)==0x40;
+                        if(!decode_integer(data, end, indexing?6:4, index))
+                            return false;
+                        std::pair<std::string, std::string> header;
+                        if(index>0) {
+                            auto entry=table.get(index);
+                            if(!entry)
+                                return false;
+                            header.first=entry->first;
+                        }
+                        else if(!decode_string(data, end, header.first))
+                            return false;
+                        if(!decode_string(data, end, header.second))
+                            return false;
+                        if(indexing)
+                            table.add(header.first, header.second);
+                        list_size+=header.first.size()+header.second.size()+32;
+                        if(list_size<=max_list_size)
+                            headers.emplace_back(std::move(header));
+                    }
+                }
+                return true;
+            }
+
+        private:
+            Table table;
+            size_t max_table_size;
+        };
+
+        class Encoder {
+        public:
+            Encoder(): table(4096), table_size(4096), size_update(false) {}
+
+            ///Follows the SETTINGS_HEADER_TABLE_SIZE of the peer; the table is never made larger than 4096 bytes
+            void set_max_table_size(size_t max_size) {
+                table_size=std::min<size_t>(max_size, 4096);
+                table.set_max_size(table_size);
+                size_update=true;
+            }
+
+            ///Appends a header field to the header block in out. name must be lower case.
+            ///Fields with indexing are added to the dynamic table, so that repeating them costs a single byte.
+            void encode(const std::string &name, const std::string &value, bool indexing, std::string &out) {
+                if(size_update) {
+                    encode_integer(table_size, 5, 0x20, out);
+                    size_update=false;
+                }
+                bool value_matched;
+                auto index=table.find(name, value, value_matched);
+                if(value_matched) {
+                    encode_integer(index, 7, 0x80, out);
+                    return;
+                }
+                if(indexing) {
+                    encode_integer(index, 6, 0x40, out);
+                    table.add(name, value);
+                }
+                else
+                    encode_integer(index, 4, 0x00, out);
+                if(index==0)
+                    encode_string(name, out);
+                encode_string(value, out);
+            }
+
+        private:
+            Table table;
+            size_t table_size;
+            bool size_update;
+        };
+
+        static bool decode_integer(const unsigned char *&data, const unsigned char *end, int prefix_bits, size_t &value) {
+            if(data==end)
+                return false;
+            size_t max_prefix=(1u<<prefix_bits)-1;
+            value=*data++&max_prefix;
+            if(value<max_prefix)
+                return true;
+            for(size_t shift=0;data!=end && shift<=28;shift+=7) {
+                auto byte=*data++;
+                value+=static_cast<size_t>(byte&0x7f)<<shift;
+                if(!(byte&0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        static void encode_integer(size_t value, int prefix_bits, unsigned char first, std::string &out) {
+            size_t max_prefix=(1u<<prefix_bits)-1;
+            if(value<max_prefix) {
+                out+=static_cast<char>(first|value);
+                return;
+            }
+            out+=static_cast<char>(first|max_prefix);
+            value-=max_prefix;
+            for(;value>=0x80;value>>=7)
+                out+=static_cast<char>((value&0x7f)|0x80);
+            out+=static_cast<char>(value);
+        }
+
+        static bool decode_string(const unsigned char *&data, const unsigned char *end, std::string &value) {
+            if(data==end)
+                return false;
+            bool huffman=*data&0x80;
+            size_t length;
+            if(!decode_integer(data, end, 7, length) || length>static_cast<size_t>(end-data))
+                return false;
+            if(huffman) {
+                if(!huffman_decode(data, length, value))
+                    return false;
+            }
+            else
+                value.assign(reinterpret_cast<const char*>(data), length);
+            data+=length;
+            return true;
+        }
+
+        ///Strings are sent without Huffman coding, which costs a few bytes but no time
+        static void encode_string(const std::string &value, std::string &out) {
+            encode_integer(value.size(), 7, 0x00, out);
+            out+=value;
+        }
+
+        static bool huffman_decode(const unsigned char *data, size_t size, std::string &out) {
+            auto &code_table=huffman_table();
+            //Canonical decoding: codes of the same length are consecutive, and shorter codes come first
+            int code=0, first=0, index=0, length=0;
+            bool padding_ones=true;
+            for(size_t c=0;c<size;c++) {
+                for(int bit=7;bit>=0;bit--) {
+                    int value=(data[c]>>bit)&1;
+                    padding_ones=padding_ones && value;
+                    code|=value;
+                    length++;
+                    int count=code_table.count[length];
+                    if(code-count<first) {
+                        auto symbol=code_table.symbols[index+(code-first)];
+                        if(symbol==256)
+                            return false;
+                        out+=static_cast<char>(symbol);
+                        code=first=index=length=0;
+                        padding_ones=true;
+                        continue;
+                    }
+                    index+=count;
+                    first+=count;
+                    first<<=1;
+                    code<<=1;
+                    if(length>=30)
+                        return false;
+                }
+            }
+            //Up to 7 bits of padding, taken from the most significant bits of the end-of-string code
+            return length<8 && padding_ones;
+        }
+
+    private:
+        static const std::vector<std::pair<std::string, std::string> > &static_table() {
+            static const std::vector<std::pair<std::string, std::string> > table={
+                {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"}, {":path", "/index.html"},
+                {":scheme", "http"}, {":scheme", "https"}, {":status", "200"}, {":status", "204"}, {":status", "206"},
+                {":status", "304"}, {":status", "400"}, {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+                {"accept-encoding", "gzip, deflate"}, {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""},
+                {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+                {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+                {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""}, {"date", ""},
+                {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""}, {"if-match", ""},
+                {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""},
+                {"last-modified", ""}, {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+                {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""}, {"retry-after", ""},
+                {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""}, {"transfer-encoding", ""},
+                {"user-agent", ""}, {"vary", ""}, {"via", ""}, {"www-authenticate", ""}
+            };
+            return table;
+        }
+
+        class HuffmanTable {
+        public:
+            int count[31];
+            std::vector<int> symbols;
+
+            HuffmanTable() {
+                //Code length of each symbol (RFC 7541, Appendix B); symbol 256 is the end-of-string code
+                static const unsigned char lengths[257]={
+                    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+                    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+                    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+                    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+                    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+                    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+                    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+                    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+                    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+                    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+                    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+                    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+                    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+                    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+                    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+                    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+                    30
+                };
+                std::fill(count, count+31, 0);
+                for(int length=1;length<=30;length++) {
+                    for(int symbol=0;symbol<257;symbol++) {
+                        if(lengths[symbol]==length) {
+                            count[length]++;
+                            symbols.emplace_back(symbol);
+                        }
+                    }
+                }
+            }
+        };
+
+        static const HuffmanTable &huffman_table() {
+            static const HuffmanTable table;
+            return table;
+        }
+    };
+
+    ///Serves HTTP/2 (RFC 7540) through the resource functions of a server. Connections are taken over when they start
+    ///with the HTTP/2 connection preface (prior knowledge, or after ALPN selected h2 on a Server<HTTPS>),
+    ///or when a request asks for Upgrade: h2c.
+    ///
+    ///Each stream becomes a Request passed to ServerBase::dispatch() with a detached Response. Once the resource
+    ///function has released the response, its status line and header are converted to a HEADERS frame, and its
+    ///content is sent in DATA frames interleaved with the other streams, within the flow control windows of the
+    ///client and in the order of its stream priorities. Responses are therefore buffered until complete.
+    ///
+    ///Request content counts toward the admission limits of the server as it arrives, and streams are subject to its
+    ///timeouts and config.min_transfer_rate; streams that exceed them are refused, answered with 408 or reset.
+    template<class socket_type>
+    class Http2 {
+    public:
+        class Config {
+            friend class Http2<socket_type>;
+
+            Config(): max_concurrent_streams(128), initial_window_size(1<<20), connection_window_size(16<<20), idle_timeout(300) {}
+        public:
+            /// Streams a client may have open at the same time.
+            size_t max_concurrent_streams;
+            /// Bytes a client may send on a stream before the server acknowledges them.
+            size_t initial_window_size;
+            /// Bytes a client may send on all streams of a connection before the server acknowledges them.
+            size_t connection_window_size;
+            /// Seconds a connection without open streams is kept.
+            size_t idle_timeout;
+        };
+
+        Config config;
+
+        ///Takes over the HTTP/2 connections of server. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.on_upgrade=[this, &server](const std::shared_ptr<socket_type> &socket, const std::shared_ptr<typename ServerBase<socket_type>::Request> &request) {
+                if(request->method=="PRI" && request->path=="*" && request->http_version=="2.0") {
+                    std::make_shared<Connection>(server, config, socket)->start(request, false);
+                    return true;
+                }
+                auto upgrade=request->header.find("Upgrade");
+                if(upgrade!=request->header.end() && boost::icontains(upgrade->second, "h2c") &&
+                   request->header.find("HTTP2-Settings")!=request->header.end()) {
+                    std::make_shared<Connection>(server, config, socket)->start(request, true);
+                    return true;
+                }
+                return false;
+            };
+        }
+
+    private:
+        enum FrameType {DATA=0x0, HEADERS=0x1, PRIORITY=0x2, RST_STREAM=0x3, SETTINGS=0x4, PUSH_PROMISE=0x5, PING=0x6,
+                        GOAWAY=0x7, WINDOW_UPDATE=0x8, CONTINUATION=0x9};
+        enum Flag {END_STREAM=0x1, ACK=0x1, END_HEADERS=0x4, PADDED=0x8, PRIORITY_FLAG=0x20};
+        enum ErrorCode {NO_ERROR=0x0, PROTOCOL_ERROR=0x1, INTERNAL_ERROR=0x2, FLOW_CONTROL_ERROR=0x3, STREAM_CLOSED=0x5,
+                        FRAME_SIZE_ERROR=0x6, REFUSED_STREAM=0x7, CANCEL=0x8, COMPRESSION_ERROR=0x9, ENHANCE_YOUR_CALM=0xb};
+
+        static const size_t max_frame_size=16384;
+        static const size_t max_write_size=65536;
+
+        class Priority {
+        public:
+            Priority(): dependency(0), weight(16) {}
+            uint32_t dependency;
+            unsigned weight;
+        };
+
+        class Stream {
+        public:
+            Stream(int64_t send_window, int64_t receive_window) :
+                    send_window(send_window), receive_window(receive_window), end_stream_received(false), responding(false),
+                    data_offset(0), virtual_finish(0), received(0), start(std::chrono::steady_clock::now()) {}
+            std::shared_ptr<typename ServerBase<socket_type>::Request> request;
+            int64_t send_window, receive_window;
+            bool end_stream_received, responding;
+            std::string data;
+            size_t data_offset;
+            double virtual_finish;
+            ///Content bytes received since phase_start
+            size_t received;
+            ///phase_start and deadline are those of receiving the content, and later of sending the response
+            std::chrono::steady_clock::time_point start, phase_start, deadline;
+        };
+
+        class Connection : public std::enable_shared_from_this<Connection> {
+        public:
+            Connection(ServerBase<socket_type> &server, const Config &config, const std::shared_ptr<socket_type> &socket) :
+                    server(server), config(config), socket(socket), strand(*server.io_service), idle_timer(*server.io_service),
+                    read_buffer(max_write_size), input_position(0), decoder(4096), last_stream_id(0), header_block_stream(0),
+                    header_block_end_stream(false), connection_send_window(65535), connection_receive_window(0),
+                    peer_initial_window(65535), peer_max_frame_size(max_frame_size), writing(false), closing(false),
+                    goaway_received(false), writing_transferred(0), virtual_time(0), last_activity(std::chrono::steady_clock::now()) {}
+
+            void start(const std::shared_ptr<typename ServerBase<socket_type>::Request> &request, bool upgrade) {
+                remote_endpoint_address=request->remote_endpoint_address;
+                remote_endpoint_port=request->remote_endpoint_port;
+                if(upgrade) {
+                    pending_output="HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+                    preface_remaining="PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+                    auto settings=base64url_decode(request->header.find("HTTP2-Settings")->second);
+                    apply_settings(reinterpret_cast<const unsigned char*>(settings.data()), settings.size()-settings.size()%6);
+                }
+                else {
+                    //The request line and blank line of the preface have been read as a request already
+                    preface_remaining="SM\r\n\r\n";
+                }
+                //Without Content-Length, what has been read past the request header already belongs to the HTTP/2 connection
+                if(request->header.find("Content-Length")==request->header.end()) {
+                    std::string leftover(request->content.size(), '\0');
+                    if(!leftover.empty())
+                        request->content.rdbuf()->sgetn(&leftover[0], static_cast<std::streamsize>(leftover.size()));
+                    input=std::move(leftover);
+                }
+
+                //Server connection preface
+                std::string settings;
+                append_setting(settings, 0x3, static_cast<uint32_t>(config.max_concurrent_streams));
+                append_setting(settings, 0x4, static_cast<uint32_t>(config.initial_window_size));
+                append_setting(settings, 0x6, static_cast<uint32_t>(server.config.max_header_bytes));
+                append_frame(SETTINGS, 0, 0, settings.data(), settings.size());
+                connection_receive_window=static_cast<int64_t>(config.connection_window_size);
+                if(config.connection_window_size>65535)
+                    append_window_update(0, static_cast<uint32_t>(config.connection_window_size-65535));
+
+                //The upgrade request is stream 1, half-closed since it was read completely
+                if(upgrade) {
+                    last_stream_id=1;
+                    auto &stream=streams.emplace(1, Stream(peer_initial_window, 0)).first->second;
+                    stream.end_stream_received=true;
+                    stream.request=request;
+                    request->http_version="2.0";
+                    dispatch(1, stream);
+                }
+
+                auto self=this->shared_from_this();
+                strand.dispatch([self] {
+                    self->process_input();
+                    self->flush();
+                    if(!self->closing)
+                        self->read();
+                });
+                wait_timeouts();
+            }
+
+        private:
+            ServerBase<socket_type> &server;
+            const Config &config;
+            std::shared_ptr<socket_type> socket;
+            boost::asio::io_service::strand strand;
+            boost::asio::steady_timer idle_timer;
+            std::string remote_endpoint_address;
+            unsigned short remote_endpoint_port;
+
+            std::vector<char> read_buffer;
+            std::string input;
+            size_t input_position;
+            std::string preface_remaining;
+
+            Hpack::Decoder decoder;
+            Hpack::Encoder encoder;
+            std::string header_block;
+            std::chrono::steady_clock::time_point header_block_start;
+
+            std::map<uint32_t, Stream> streams;
+            std::map<uint32_t, Priority> priorities;
+            uint32_t last_stream_id;
+            uint32_t header_block_stream;
+            bool header_block_end_stream;
+
+            int64_t connection_send_window, connection_receive_window;
+            uint32_t peer_initial_window, peer_max_frame_size;
+
+            std::string pending_output, writing_output;
+            bool writing, closing, goaway_received;
+            size_t writing_transferred;
+            std::chrono::steady_clock::time_point writing_start;
+            double virtual_time;
+            std::chrono::steady_clock::time_point last_activity;
+
+            void read() {
+                auto self=this->shared_from_this();
+                socket->async_read_some(boost::asio::buffer(read_buffer), strand.wrap([self](const boost::system::error_code &ec, size_t bytes_transferred) {
+                    if(ec) {
+                        self->close();
+                        return;
+                    }
+                    self->last_activity=std::chrono::steady_clock::now();
+                    self->input.append(self->read_buffer.data(), bytes_transferred);
+                    self->process_input();
+                    self->flush();
+                    if(!self->closing)
+                        self->read();
+                }));
+            }
+
+            ///Checks the timeouts every second
+            void wait_timeouts() {
+                auto self=this->shared_from_this();
+                idle_timer.expires_from_now(std::chrono::seconds(1));
+                idle_timer.async_wait(strand.wrap([self](const boost::system::error_code &ec) {
+                    if(ec || self->closing)
+                        return;
+                    self->check_timeouts();
+                    if(self->closing)
+                        return;
+                    self->flush();
+                    self->wait_timeouts();
+                }));
+            }
+
+            ///Applies the timeouts of the server as it does to HTTP/1.1 connections: the header block of a stream has to arrive
+            ///within timeout_request, its content and then its response within timeout_content, each at config.min_transfer_rate
+            void check_timeouts() {
+                auto now=std::chrono::steady_clock::now();
+                if(header_block_stream!=0 && server.request_timeout()>0 && now>=header_block_start+std::chrono::seconds(server.request_timeout())) {
+                    connection_error(NO_ERROR);
+                    return;
+                }
+                //A write that is too slow holds up all streams
+                if(writing && ((server.content_timeout()>0 && now>=writing_start+std::chrono::seconds(server.content_timeout())) ||
+                               too_slow(writing_start, writing_transferred, now))) {
+                    close();
+                    return;
+                }
+                if(streams.empty() && header_block_stream==0 && !writing && now>=last_activity+std::chrono::seconds(config.idle_timeout)) {
+                    connection_error(NO_ERROR);
+                    return;
+                }
+                for(auto it=streams.begin();it!=streams.end();) {
+                    auto id=it->first;
+                    auto &stream=it->second;
+                    it++;
+                    if(stream.request && !stream.end_stream_received) {
+                        if(now>=stream.deadline || too_slow(stream.phase_start, stream.received, now)) {
+                            //The client is asked to stop sending after the response (RFC 7540, 8.1)
+                            stream.end_stream_received=true;
+                            respond(id, "HTTP/1.1 408 Request Timeout\r\nContent-Length: 0\r\n\r\n");
+                            reset_stream(id, NO_ERROR);
+                        }
+                    }
+                    else if(stream.responding && now>=stream.deadline)
+                        reset_stream(id, CANCEL);
+                }
+            }
+
+            bool too_slow(std::chrono::steady_clock::time_point phase_start, size_t bytes, std::chrono::steady_clock::time_point now) const {
+                if(server.config.min_transfer_rate==0)
+                    return false;
+                auto elapsed=std::chrono::duration<double>(now-phase_start).count();
+                return elapsed>=1.0 && static_cast<double>(bytes)<elapsed*server.config.min_transfer_rate;
+            }
+
+            void close() {
+                closing=true;
+                boost::system::error_code ec;
+                idle_timer.cancel(ec);
+                socket->lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+                socket->lowest_layer().close(ec);
+            }
+
+            void process_input() {
+                while(!closing) {
+                    size_t available=input.size()-input_position;
+                    if(!preface_remaining.empty()) {
+                        auto length=std::min(available, preface_remaining.size());
+                        if(input.compare(input_position, length, preface_remaining, 0, length)!=0) {
+                            close();
+                            return;
+                        }
+                        input_position+=length;
+                        preface_remaining.erase(0, length);
+                        if(!preface_remaining.empty())
+                            break;
+                        continue;
+                    }
+                    if(available<9)
+                        break;
+                    auto header=reinterpret_cast<const unsigned char*>(&input[input_position]);
+                    size_t length=(static_cast<size_t>(header[0])<<16)|(static_cast<size_t>(header[1])<<8)|header[2];
+                    if(length>max_frame_size) {
+                        connection_error(FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    if(available<9+length)
+                        break;
+                    input_position+=9+length;
+                    handle_frame(header[3], header[4], read32(header+5)&0x7fffffff, header+9, length);
+                }
+                if(input_position==input.size()) {
+                    input.clear();
+                    input_position=0;
+                }
+                else if(input_position>=max_write_size) {
+                    input.erase(0, input_position);
+                    input_position=0;
+                }
+            }
+
+            void handle_frame(unsigned char type, unsigned char flags, uint32_t id, const unsigned char *payload, size_t length) {
+                if(header_block_stream!=0 && (type!=CONTINUATION || id!=header_block_stream)) {
+                    connection_error(PROTOCOL_ERROR);
+                    return;
+                }
+                switch(type) {
+                case DATA:
+                    handle_data(flags, id, payload, length);
+                    break;
+                case HEADERS:
+                    handle_headers(flags, id, payload, length);
+                    break;
+                case PRIORITY:
+                    if(id==0 || length!=5) {
+                        connection_error(id==0?PROTOCOL_ERROR:FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    set_priority(id, read32(payload), payload[4]);
+                    break;
+                case RST_STREAM:
+                    if(id==0 || length!=4) {
+                        connection_error(id==0?PROTOCOL_ERROR:FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    close_stream(id);
+                    break;
+                case SETTINGS:
+                    if(id!=0 || (flags&ACK && length!=0) || length%6!=0) {
+                        connection_error(id!=0?PROTOCOL_ERROR:FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    if(!(flags&ACK) && apply_settings(payload, length))
+                        append_frame(SETTINGS, ACK, 0, nullptr, 0);
+                    break;
+                case PUSH_PROMISE:
+                    connection_error(PROTOCOL_ERROR);
+                    break;
+                case PING:
+                    if(id!=0 || length!=8) {
+                        connection_error(id!=0?PROTOCOL_ERROR:FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    if(!(flags&ACK))
+                        append_frame(PING, ACK, 0, payload, length);
+                    break;
+                case GOAWAY:
+                    goaway_received=true;
+                    break;
+                case WINDOW_UPDATE:
+                    handle_window_update(id, payload, length);
+                    break;
+                case CONTINUATION:
+                    if(header_block_stream==0) {
+                        connection_error(PROTOCOL_ERROR);
+                        return;
+                    }
+                    header_block.append(reinterpret_cast<const char*>(payload), length);
+                    if(header_block.size()>server.config.max_header_bytes*2) {
+                        connection_error(ENHANCE_YOUR_CALM);
+                        return;
+                    }
+                    if(flags&END_HEADERS) {
+                        header_block_stream=0;
+                        headers_complete(id);
+                    }
+                    break;
+                default:
+                    //Unknown frame types are ignored
+                    break;
+                }
+            }
+
+            ///Removes padding from payload, or returns false if the padding is invalid
+            bool strip_padding(unsigned char flags, const unsigned char *&payload, size_t &length) {
+                if(!(flags&PADDED))
+                    return true;
+                if(length<1 || payload[0]>=length)
+                    return false;
+                length-=payload[0]+1;
+                payload++;
+                return true;
+            }
+
+            void handle_data(unsigned char flags, uint32_t id, const unsigned char *payload, size_t length) {
+                if(id==0) {
+                    connection_error(PROTOCOL_ERROR);
+                    return;
+                }
+                //Flow control counts the whole payload, including padding
+                connection_receive_window-=static_cast<int64_t>(length);
+                if(connection_receive_window<0) {
+                    connection_error(FLOW_CONTROL_ERROR);
+                    return;
+                }
+                if(connection_receive_window<static_cast<int64_t>(config.connection_window_size/2)) {
+                    append_window_update(0, static_cast<uint32_t>(static_cast<int64_t>(config.connection_window_size)-connection_receive_window));
+                    connection_receive_window=static_cast<int64_t>(config.connection_window_size);
+                }
+                auto full_length=length;
+                if(!strip_padding(flags, payload, length)) {
+                    connection_error(PROTOCOL_ERROR);
+                    return;
+                }
+                auto it=streams.find(id);
+                if(it==streams.end() || it->second.end_stream_received) {
+                    if(id>last_stream_id)
+                        connection_error(PROTOCOL_ERROR);
+                    else
+                        reset_stream(id, STREAM_CLOSED);
+                    return;
+                }
+                auto &stream=it->second;
+                stream.receive_window-=static_cast<int64_t>(full_length);
+                if(stream.receive_window<0) {
+                    reset_stream(id, FLOW_CONTROL_ERROR);
+                    return;
+                }
+                if(length>0) {
+                    if(!server.reserve(stream.request, length)) {
+                        reset_stream(id, REFUSED_STREAM);
+                        return;
+                    }
+                    stream.request->content.rdbuf()->sputn(reinterpret_cast<const char*>(payload), static_cast<std::streamsize>(length));
+                    stream.received+=length;
+                }
+                if(flags&END_STREAM) {
+                    stream.end_stream_received=true;
+                    dispatch(id, stream);
+                }
+                else if(stream.receive_window<static_cast<int64_t>(config.initial_window_size/2)) {
+                    append_window_update(id, static_cast<uint32_t>(static_cast<int64_t>(config.initial_window_size)-stream.receive_window));
+                    stream.receive_window=static_cast<int64_t>(config.initial_window_size);
+                }
+            }
+
+            void handle_headers(unsigned char flags, uint32_t id, const unsigned char *payload, size_t length) {
+                if(id==0 || id%2==0 || !strip_padding(flags, payload, length)) {
+                    connection_error(PROTOCOL_ERROR);
+                    return;
+                }
+                if(flags&PRIORITY_FLAG) {
+                    if(length<5) {
+                        connection_error(FRAME_SIZE_ERROR);
+                        return;
+                    }
+                    set_priority(id, read32(payload), payload[4]);
+                    payload+=5;
+                    length-=5;
+                }
+                if(streams.find(id)==streams.end()) {
+                    if(id<=last_stream_id) {
+                        connection_error(PROTOCOL_ERROR);
+                        return;
+                    }
+                    last_stream_id=id;
+                    //The header block is decoded in any case, to keep the compression state in sync
+                    if(streams.size()<config.max_concurrent_streams && !goaway_received)
+                        streams.emplace(id, Stream(peer_initial_window, static_cast<int64_t>(config.initial_window_size)));
+                }
+                header_block.assign(reinterpret_cast<const char*>(payload), length);
+                header_block_end_stream=flags&END_STREAM;
+                if(flags&END_HEADERS)
+                    headers_complete(id);
+                else {
+                    header_block_stream=id;
+                    header_block_start=std::chrono::steady_clock::now();
+                }
+            }
+
+            void headers_complete(uint32_t id) {
+                Hpack::header_list headers;
+                size_t header_bytes;
+                if(!decoder.decode(reinterpret_cast<const unsigned char*>(header_block.data()), header_block.size(),
+                                   server.config.max_header_bytes, headers, header_bytes)) {
+                    connection_error(COMPRESSION_ERROR);
+                    return;
+                }
+                header_block.clear();
+
+                auto it=streams.find(id);
+                if(it==streams.end()) {
+                    if(id==last_stream_id)
+                        reset_stream(id, REFUSED_STREAM);
+                    return;
+                }
+                auto &stream=it->second;
+                if(stream.request) {
+                    //Trailers end the stream, and are not passed on
+                    if(stream.end_stream_received || !header_block_end_stream || header_bytes>server.config.max_header_bytes) {
+                        reset_stream(id, PROTOCOL_ERROR);
+                        return;
+                    }
+                    stream.end_stream_received=true;
+                    dispatch(id, stream);
+                    return;
+                }
+
+                stream.request=server.create_request();
+                auto &request=*stream.request;
+                request.http_version="2.0";
+                request.remote_endpoint_address=remote_endpoint_address;
+                request.remote_endpoint_port=remote_endpoint_port;
+                if(header_bytes>server.config.max_header_bytes) {
+                    stream.end_stream_received=true;
+                    respond(id, "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\n\r\n");
+                    return;
+                }
+
+                std::string authority, cookie;
+                bool regular=false;
+                for(auto &header: headers) {
+                    if(!header.first.empty() && header.first[0]==':') {
+                        if(regular) {
+                            reset_stream(id, PROTOCOL_ERROR);
+                            return;
+                        }
+                        if(header.first==":method")
+                            request.method=header.second;
+                        else if(header.first==":path")
+                            request.path=header.second;
+                        else if(header.first==":authority")
+                            authority=header.second;
+                        else if(header.first!=":scheme") {
+                            reset_stream(id, PROTOCOL_ERROR);
+                            return;
+                        }
+                        continue;
+                    }
+                    regular=true;
+                    if(header.first=="connection" || header.first=="keep-alive" || header.first=="proxy-connection" ||
+                       header.first=="transfer-encoding" || header.first=="upgrade") {
+                        reset_stream(id, PROTOCOL_ERROR);
+                        return;
+                    }
+                    //Cookies may be split into several fields (RFC 7540, 8.1.2.5)
+                    if(header.first=="cookie")
+                        cookie+=(cookie.empty()?"":"; ")+header.second;
+                    else
+                        request.header.emplace(header.first, header.second);
+                }
+                if(request.method.empty() || request.path.empty()) {
+                    reset_stream(id, PROTOCOL_ERROR);
+                    return;
+                }
+                if(!authority.empty() && request.header.find("host")==request.header.end())
+                    request.header.emplace("host", authority);
+                if(!cookie.empty())
+                    request.header.emplace("cookie", cookie);
+
+                //Admitted on its header, so that its content counts toward the limits of the server as it arrives
+                if(!server.admit(stream.request, 0)) {
+                    reset_stream(id, REFUSED_STREAM);
+                    return;
+                }
+                if(header_block_end_stream) {
+                    stream.end_stream_received=true;
+                    dispatch(id, stream);
+                }
+                else
+                    start_phase(stream, server.content_timeout());
+            }
+
+            static void start_phase(Stream &stream, long seconds) {
+                stream.phase_start=std::chrono::steady_clock::now();
+                stream.deadline=seconds>0?stream.phase_start+std::chrono::seconds(seconds):std::chrono::steady_clock::time_point::max();
+            }
+
+            void handle_window_update(uint32_t id, const unsigned char *payload, size_t length) {
+                if(length!=4) {
+                    connection_error(FRAME_SIZE_ERROR);
+                    return;
+                }
+                auto increment=read32(payload)&0x7fffffff;
+                if(id==0) {
+                    connection_send_window+=increment;
+                    if(increment==0 || connection_send_window>0x7fffffff)
+                        connection_error(increment==0?PROTOCOL_ERROR:FLOW_CONTROL_ERROR);
+                    return;
+                }
+                auto it=streams.find(id);
+                if(it==streams.end())
+                    return;
+                it->second.send_window+=increment;
+                if(increment==0 || it->second.send_window>0x7fffffff)
+                    reset_stream(id, increment==0?PROTOCOL_ERROR:FLOW_CONTROL_ERROR);
+            }
+
+            ///Returns false after a connection error
+            bool apply_settings(const unsigned char *payload, size_t length) {
+                for(size_t c=0;c+6<=length;c+=6) {
+                    auto identifier=(static_cast<unsigned>(payload[c])<<8)|payload[c+1];
+                    auto value=read32(payload+c+2);
+                    switch(identifier) {
+                    case 0x1:
+                        encoder.set_max_table_size(value);
+                        break;
+                    case 0x2:
+                        if(value>1) {
+                            connection_error(PROTOCOL_ERROR);
+                            return false;
+                        }
+                        break;
+                    case 0x4:
+                        if(value>0x7fffffff) {
+                            connection_error(FLOW_CONTROL_ERROR);
+                            return false;
+                        }
+                        for(auto &stream: streams)
+                            stream.second.send_window+=static_cast<int64_t>(value)-peer_initial_window;
+                        peer_initial_window=value;
+                        break;
+                    case 0x5:
+                        if(value<16384 || value>16777215) {
+                            connection_error(PROTOCOL_ERROR);
+                            return false;
+                        }
+                        peer_max_frame_size=value;
+                        break;
+                    default:
+                        break;
+                    }
+                }
+                return true;
+            }
+
+            void set_priority(uint32_t id, uint32_t dependency_field, unsigned char weight) {
+                auto dependency=dependency_field&0x7fffffff;
+                if(dependency==id)
+                    return;
+                //An exclusive dependency makes the stream the only child of its parent
+                if(dependency_field&0x80000000) {
+                    for(auto &priority: priorities) {
+                        if(priority.second.dependency==dependency)
+                            priority.second.dependency=id;
+                    }
+                }
+                auto &priority=priorities[id];
+                priority.dependency=dependency;
+                priority.weight=weight+1u;
+                //Priorities of closed streams are kept as long as other streams may depend on them, within a bound
+                for(auto it=priorities.begin();priorities.size()>4*config.max_concurrent_streams && it!=priorities.end();) {
+                    if(streams.find(it->first)==streams.end() && it->first!=id)
+                        it=priorities.erase(it);
+                    else
+                        it++;
+                }
+            }
+
+            void dispatch(uint32_t id, Stream &stream) {
+                auto self=this->shared_from_this();
+                auto request=stream.request;
+                auto response=server.create_detached_response([self, id](typename ServerBase<socket_type>::Response &captured) {
+                    auto output=std::make_shared<std::string>(captured.size(), '\0');
+                    if(!output->empty())
+                        captured.rdbuf()->sgetn(&(*output)[0], static_cast<std::streamsize>(output->size()));
+                    self->strand.dispatch([self, id, output] {
+                        self->respond(id, *output);
+                        self->flush();
+                    });
+                });
+                if(!server.dispatch(request, response))
+                    *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+            }
+
+            ///Sends the HTTP/1.1 response written by a resource function on stream id
+            void respond(uint32_t id, const std::string &output) {
+                auto it=streams.find(id);
+                if(it==streams.end() || closing)
+                    return;
+                auto &stream=it->second;
+
+                auto header_end=output.find("\r\n\r\n");
+                unsigned short status_code=0;
+                if(header_end!=std::string::npos && output.size()>=12 && std::isdigit(output[9]) && std::isdigit(output[10]) && std::isdigit(output[11]))
+                    status_code=static_cast<unsigned short>((output[9]-'0')*100+(output[10]-'0')*10+(output[11]-'0'));
+                if(status_code==0) {
+                    reset_stream(id, INTERNAL_ERROR);
+                    return;
+                }
+
+                std::string block;
+                encoder.encode(":status", output.substr(9, 3), true, block);
+                bool chunked=false;
+                for(size_t line_start=output.find("\r\n")+2;line_start<header_end;) {
+                    auto line_end=output.find("\r\n", line_start);
+                    auto colon=output.find(':', line_start);
+                    if(colon<line_end) {
+                        auto name=output.substr(line_start, colon-line_start);
+                        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                        auto value_start=output.find_first_not_of(' ', colon+1);
+                        auto value=value_start<line_end?output.substr(value_start, line_end-value_start):std::string();
+                        if(name=="transfer-encoding")
+                            chunked=boost::icontains(value, "chunked");
+                        else if(name!="connection" && name!="keep-alive" && name!="proxy-connection" && name!="upgrade")
+                            encoder.encode(name, value, name!="content-length" && name!="date" && name!="etag", block);
+                    }
+                    line_start=line_end+2;
+                }
+
+                auto content_start=header_end+4;
+                if(chunked)
+                    stream.data=dechunk(output, content_start);
+                else if(stream.request->method!="HEAD")
+                    stream.data=output.substr(content_start);
+                if(server.on_response)
+                    server.on_response(*stream.request, status_code, output.size(), std::chrono::steady_clock::now()-stream.start);
+
+                bool end_stream=stream.data.empty();
+                append_header_block(id, block, end_stream);
+                if(end_stream)
+                    close_stream(id);
+                else {
+                    stream.responding=true;
+                    stream.virtual_finish=virtual_time;
+                    start_phase(stream, server.content_timeout());
+                }
+            }
+
+            static std::string dechunk(const std::string &output, size_t position) {
+                std::string content;
+                while(position<output.size()) {
+                    auto line_end=output.find("\r\n", position);
+                    if(line_end==std::string::npos)
+                        break;
+                    size_t length;
+                    try {
+                        length=std::stoul(output.substr(position, line_end-position), nullptr, 16);
+                    }
+                    catch(const std::exception &) {
+                        break;
+                    }
+                    if(length==0)
+                        break;
+                    content.append(output, line_end+2, length);
+                    position=line_end+2+length+2;
+                }
+                return content;
+            }
+
+            ///Appends DATA frames of the responding streams, as far as the flow control windows allow. Among the streams that
+            ///do not depend on a stream with data to send, the one that has been served least relative to its weight goes first.
+            void schedule_data() {
+                while(pending_output.size()<max_write_size && connection_send_window>0) {
+                    Stream *next=nullptr;
+                    uint32_t next_id=0;
+                    for(auto &stream: streams) {
+                        if(sendable(stream.second) && !blocked(stream.first) && (!next || stream.second.virtual_finish<next->virtual_finish)) {
+                            next=&stream.second;
+                            next_id=stream.first;
+                        }
+                    }
+                    if(!next)
+                        break;
+                    auto length=std::min<int64_t>(std::min<int64_t>(next->data.size()-next->data_offset, next->send_window),
+                                                  std::min<int64_t>(connection_send_window, peer_max_frame_size));
+                    bool end_stream=next->data_offset+length==next->data.size();
+                    append_frame(DATA, end_stream?END_STREAM:0, next_id, next->data.data()+next->data_offset, static_cast<size_t>(length));
+                    next->data_offset+=length;
+                    next->send_window-=length;
+                    connection_send_window-=length;
+                    virtual_time=next->virtual_finish;
+                    next->virtual_finish+=static_cast<double>(length)/priority(next_id).weight;
+                    if(end_stream)
+                        close_stream(next_id);
+                }
+            }
+
+            static bool sendable(const Stream &stream) {
+                return stream.responding && stream.data_offset<stream.data.size() && stream.send_window>0;
+            }
+
+            bool blocked(uint32_t id) const {
+                auto dependency=priority(id).dependency;
+                for(int depth=0;dependency!=0 && depth<32;depth++) {
+                    auto it=streams.find(dependency);
+                    if(it!=streams.end() && sendable(it->second))
+                        return true;
+                    dependency=priority(dependency).dependency;
+                }
+                return false;
+            }
+
+            Priority priority(uint32_t id) const {
+                auto it=priorities.find(id);
+                return it!=priorities.end()?it->second:Priority();
+            }
+
+            void flush() {
+                if(writing)
+                    return;
+                if(!closing)
+                    schedule_data();
+                if(pending_output.empty()) {
+                    if(closing || (goaway_received && streams.empty()))
+                        close();
+                    return;
+                }
+                writing=true;
+                writing_output.swap(pending_output);
+                pending_output.clear();
+                writing_transferred=0;
+                writing_start=std::chrono::steady_clock::now();
+                auto self=this->shared_from_this();
+                boost::asio::async_write(*socket, boost::asio::buffer(writing_output), [self](const boost::system::error_code &ec, size_t bytes_transferred) -> size_t {
+                    self->writing_transferred=bytes_transferred;
+                    return ec?0:65536;
+                }, strand.wrap([self](const boost::system::error_code &ec, size_t) {
+                    self->writing=false;
+                    self->writing_output.clear();
+                    if(ec) {
+                        self->close();
+                        return;
+                    }
+                    self->flush();
+                }));
+            }
+
+            void close_stream(uint32_t id) {
+                streams.erase(id);
+            }
+
+            void reset_stream(uint32_t id, ErrorCode error) {
+                unsigned char payload[4];
+                write32(payload, error);
+                append_frame(RST_STREAM, 0, id, payload, 4);
+                close_stream(id);
+            }
+
+            void connection_error(ErrorCode error) {
+                if(closing)
+                    return;
+                unsigned char payload[8];
+                write32(payload, last_stream_id);
+                write32(payload+4, error);
+                append_frame(GOAWAY, 0, 0, payload, 8);
+                closing=true;
+                flush();
+            }
+
+            void append_header_block(uint32_t id, const std::string &block, bool end_stream) {
+                size_t position=0;
+                bool first=true;
+                do {
+                    auto length=std::min<size_t>(block.size()-position, peer_max_frame_size);
+                    unsigned char flags=position+length==block.size()?END_HEADERS:0;
+                    if(first && end_stream)
+                        flags|=END_STREAM;
+                    append_frame(first?HEADERS:CONTINUATION, flags, id, block.data()+position, length);
+                    position+=length;
+                    first=false;
+                } while(position<block.size());
+            }
+
+            void append_window_update(uint32_t id, uint32_t increment) {
+                unsigned char payload[4];
+                write32(payload, increment);
+                append_frame(WINDOW_UPDATE, 0, id, payload, 4);
+            }
+
+            void append_frame(unsigned char type, unsigned char flags, uint32_t id, const void *payload, size_t length) {
+                unsigned char header[9]={static_cast<unsigned char>(length>>16), static_cast<unsigned char>(length>>8),
+                                         static_cast<unsigned char>(length), type, flags};
+                write32(header+5, id);
+                pending_output.append(reinterpret_cast<const char*>(header), 9);
+                if(length>0)
+                    pending_output.append(static_cast<const char*>(payload), length);
+            }
+
+            static void append_setting(std::string &settings, unsigned identifier, uint32_t value) {
+                unsigned char setting[6]={static_cast<unsigned char>(identifier>>8), static_cast<unsigned char>(identifier)};
+                write32(setting+2, value);
+                settings.append(reinterpret_cast<const char*>(setting), 6);
+            }
+
+            static uint32_t read32(const unsigned char *data) {
+                return (static_cast<uint32_t>(data[0])<<24)|(static_cast<uint32_t>(data[1])<<16)|(static_cast<uint32_t>(data[2])<<8)|data[3];
+            }
+
+            static void write32(unsigned char *data, uint32_t value) {
+                data[0]=static_cast<unsigned char>(value>>24);
+                data[1]=static_cast<unsigned char>(value>>16);
+                data[2]=static_cast<unsigned char>(value>>8);
+                data[3]=static_cast<unsigned char>(value);
+            }
+
+            static std::string base64url_decode(const std::string &encoded) {
+                std::string decoded;
+                unsigned buffer=0;
+                int bits=0;
+                for(auto c: encoded) {
+                    int value;
+                    if(c>='A' && c<='Z') value=c-'A';
+                    else if(c>='a' && c<='z') value=c-'a'+26;
+                    else if(c>='0' && c<='9') value=c-'0'+52;
+                    else if(c=='-' || c=='+') value=62;
+                    else if(c=='_' || c=='/') value=63;
+                    else continue;
+                    buffer=(buffer<<6)|static_cast<unsigned>(value);
+                    bits+=6;
+                    if(bits>=8) {
+                        bits-=8;
+                        decoded+=static_cast<char>((buffer>>bits)&0xff);
+                    }
+                }
+                return decoded;
+            }
+        };
+    };
+}
+
+#endif	/* HTTP2_HTTP_HPP */
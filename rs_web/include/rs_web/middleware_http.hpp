@@ -0,0 +1,167 @@
+#ifndef MIDDLEWARE_HTTP_HPP
+#define	MIDDLEWARE_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+namespace SimpleWeb {
+    ///Filters are composed around a resource function at compile time, so that a request passes through
+    ///the whole chain with a single indirect call. A filter is a copyable class with the member
+    ///
+    ///    template<class Response, class Request, class Next>
+    ///    void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request, const Next &next) const;
+    ///
+    ///that calls next(response, request) to continue, or writes a complete response and returns to short-circuit.
+    template<class Handler, class... Filters>
+    class FilterChain;
+
+    template<class Handler>
+    class FilterChain<Handler> {
+    public:
+        explicit FilterChain(const Handler &handler): handler(handler) {}
+
+        template<class Response, class Request>
+        void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request) const {
+            handler(response, request);
+        }
+    private:
+        Handler handler;
+    };
+
+    template<class Handler, class Filter, class... Rest>
+    class FilterChain<Handler, Filter, Rest...> {
+    public:
+        FilterChain(const Filter &filter, const FilterChain<Handler, Rest...> &next): filter(filter), next(next) {}
+
+        template<class Response, class Request>
+        void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request) const {
+            filter(response, request, next);
+        }
+    private:
+        Filter filter;
+        FilterChain<Handler, Rest...> next;
+    };
+
+    ///A list of filters, applied in the given order. Use make_middleware to deduce the filter types.
+    template<class... Filters>
+    class Middleware;
+
+    template<>
+    class Middleware<> {
+    public:
+        template<class Handler>
+        FilterChain<Handler> wrap(const Handler &handler) const {
+            return FilterChain<Handler>(handler);
+        }
+    };
+
+    template<class Filter, class... Rest>
+    class Middleware<Filter, Rest...> {
+    public:
+        Middleware(const Filter &filter, const Rest&... rest): filter(filter), rest(rest...) {}
+
+        ///Returns handler with the filters composed around it
+        template<class Handler>
+        FilterChain<Handler, Filter, Rest...> wrap(const Handler &handler) const {
+            return FilterChain<Handler, Filter, Rest...>(filter, rest.wrap(handler));
+        }
+
+        ///Wraps every resource function and default resource function of server.
+        ///Call after all resources have been added, and before server.start().
+        template<class socket_type>
+        void apply(ServerBase<socket_type> &server) const {
+            for(auto &res: server.resource) {
+                for(auto &res_method: res.second)
+                    res_method.second=wrap(res_method.second);
+            }
+            for(auto &res_method: server.default_resource)
+                res_method.second=wrap(res_method.second);
+        }
+    private:
+        Filter filter;
+        Middleware<Rest...> rest;
+    };
+
+    template<class... Filters>
+    Middleware<Filters...> make_middleware(const Filters&... filters) {
+        return Middleware<Filters...>(filters...);
+    }
+
+    ///Filter running functions registered at runtime, for cases that are not known at compile time.
+    ///A function returns false to stop the request, after writing a response.
+    ///Copies share the same list; add functions before server.start().
+    template<class socket_type>
+    class RuntimeFilters {
+    public:
+        typedef std::function<bool(const std::shared_ptr<typename ServerBase<socket_type>::Response>&,
+                                   const std::shared_ptr<typename ServerBase<socket_type>::Request>&)> filter_function;
+
+        RuntimeFilters(): filters(std::make_shared<std::vector<filter_function> >()) {}
+
+        void add(const filter_function &filter) {
+            filters->emplace_back(filter);
+        }
+
+        template<class Response, class Request, class Next>
+        void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request, const Next &next) const {
+            for(auto &filter: *filters) {
+                if(!filter(response, request))
+                    return;
+            }
+            next(response, request);
+        }
+    private:
+        std::shared_ptr<std::vector<filter_function> > filters;
+    };
+
+    ///Rejects requests without the header "Authorization: Bearer <token>" with 401 Unauthorized.
+    class BearerAuth {
+    public:
+        explicit BearerAuth(const std::string &token): expected("Bearer "+token) {}
+
+        template<class Response, class Request, class Next>
+        void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request, const Next &next) const {
+            auto it=request->header.find("Authorization");
+            if(it!=request->header.end() && it->second==expected) {
+                next(response, request);
+                return;
+            }
+            *response << "HTTP/1.1 401 Unauthorized\r\nWWW-Authenticate: Bearer\r\nContent-Length: 0\r\n\r\n";
+        }
+    private:
+        std::string expected;
+    };
+
+    ///Reports the time from receiving the request header until the response has been written, which includes
+    ///asynchronous work done by the resource function. Rather than a filter, which could only see the response being
+    ///released by wrapping it in another allocated pointer, it is attached to ServerBase::on_response, which the server
+    ///calls for every request anyway.
+    template<class socket_type>
+    class RequestTimer {
+    public:
+        typedef std::function<void(const typename ServerBase<socket_type>::Request&, std::chrono::steady_clock::duration)> callback_type;
+
+        explicit RequestTimer(const callback_type &callback): callback(callback) {}
+
+        ///Adds the timer to server.on_response, after the function set there already. Call before server.start().
+        void attach(ServerBase<socket_type> &server) const {
+            auto previous=server.on_response;
+            auto callback=this->callback;
+            server.on_response=[previous, callback](const typename ServerBase<socket_type>::Request &request, unsigned short status_code,
+                                                    size_t bytes, std::chrono::steady_clock::duration latency) {
+                if(previous)
+                    previous(request, status_code, bytes, latency);
+                callback(request, latency);
+            };
+        }
+    private:
+        callback_type callback;
+    };
+}
+
+#endif	/* MIDDLEWARE_HTTP_HPP */
@@ -0,0 +1,429 @@
+#ifndef POINTCLOUD_HTTP_HPP
+#define	POINTCLOUD_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SimpleWeb {
+    ///Points with an optional color each
+    class PointCloud {
+    public:
+        std::string frame_id;
+        ///x, y and z of each point, in meters. Points with a coordinate that is not finite are left out when encoding.
+        std::vector<float> points;
+        ///Red, green and blue of each point, or empty
+        std::vector<unsigned char> colors;
+
+        size_t size() const {
+            return points.size()/3;
+        }
+    };
+
+    ///Streams point clouds to the 3D viewers on GET /clouds/<topic>?lod=<level of detail>, as binary frames that
+    ///map directly onto typed arrays. Each published cloud is encoded once per level of detail that is watched,
+    ///and the encoded frame is shared by all the viewers at that level. A viewer that is behind skips to the latest
+    ///cloud instead of queueing the ones in between.
+    ///
+    ///Frames are little-endian, and each of their parts starts at a multiple of 4 bytes:
+    ///- uint32 frame size in bytes, including this field
+    ///- "RSPC", uint32 version (1), uint32 sequence number, uint32 level of detail, uint32 number of points n,
+    ///  uint32 flags (1: has colors)
+    ///- float32 origin[3], float32 scale[3]: a point is origin+position*scale
+    ///- uint32 length of the frame id, followed by the frame id
+    ///- uint16 positions[3*n]
+    ///- uint8 colors[3*n], if the cloud has colors
+    ///
+    ///Level of detail 0 has every point. Level k>0 has one point per occupied voxel of voxel_size*2^(k-1) meters,
+    ///at the centroid and with the average color of the points in the voxel.
+    ///
+    ///Requests with once=1 in the query, and requests through HTTP/2, get the latest frame with a Content-Length.
+    template<class socket_type>
+    class CloudStream {
+    public:
+        class Config {
+            friend class CloudStream<socket_type>;
+
+            Config(): voxel_size(0.005f), max_lod(4) {}
+        public:
+            /// Edge of the voxels of level of detail 1, in meters.
+            float voxel_size;
+            /// Highest level of detail that can be requested.
+            size_t max_lod;
+        };
+        /// Set before calling attach().
+        Config config;
+
+        CloudStream(const ServerBase<socket_type> &server): server(server) {}
+
+        ///Adds a topic. Call before attach().
+        void add_topic(const std::string &name) {
+            topics.emplace(name, std::unique_ptr<Topic>(new Topic()));
+        }
+
+        ///Adds GET /clouds/<topic> to server. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.resource["^/clouds/([A-Za-z0-9_.-]+)(\\?.*)?$"]["GET"]=[this](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                                std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                subscribe(response, request);
+            };
+        }
+
+        ///Sends cloud to the viewers of topic. Can be called from any thread; the encoding is done by the calling thread.
+        ///Returns false if there is no such topic.
+        bool publish(const std::string &topic_name, const std::shared_ptr<const PointCloud> &cloud) {
+            auto it=topics.find(topic_name);
+            if(it==topics.end())
+                return false;
+            auto &topic=*it->second;
+
+            unsigned long sequence;
+            std::vector<bool> watched(config.max_lod+1, false);
+            {
+                std::lock_guard<std::mutex> lock(topic.mutex);
+                sequence=++topic.sequence;
+                topic.cloud=cloud;
+                topic.frames.assign(config.max_lod+1, nullptr);
+                for(auto &subscriber: topic.subscribers)
+                    watched[subscriber->lod]=true;
+            }
+
+            //Encoded without holding the lock, so that the viewers' writes are not held up
+            std::vector<std::shared_ptr<const Frame> > frames(config.max_lod+1);
+            for(size_t lod=0;lod<=config.max_lod;lod++) {
+                if(watched[lod])
+                    frames[lod]=std::make_shared<Frame>(encode(*cloud, lod, sequence));
+            }
+
+            std::lock_guard<std::mutex> lock(topic.mutex);
+            //A newer cloud was published in the meantime
+            if(topic.sequence!=sequence)
+                return true;
+            for(size_t lod=0;lod<=config.max_lod;lod++) {
+                if(frames[lod] && !topic.frames[lod])
+                    topic.frames[lod]=frames[lod];
+            }
+            for(auto &subscriber: topic.subscribers) {
+                auto &frame=topic.frames[subscriber->lod];
+                if(frame) {
+                    subscriber->pending=frame;
+                    if(!subscriber->busy)
+                        write(topic, subscriber);
+                }
+            }
+            return true;
+        }
+
+        ///Number of viewers of topic
+        size_t subscribers(const std::string &topic_name) {
+            auto it=topics.find(topic_name);
+            if(it==topics.end())
+                return 0;
+            std::lock_guard<std::mutex> lock(it->second->mutex);
+            return it->second->subscribers.size();
+        }
+
+        ///The frame of cloud at level of detail lod, without HTTP/1.1 chunk framing
+        std::string encode(const PointCloud &cloud, size_t lod, unsigned long sequence) const {
+            std::vector<float> points;
+            std::vector<unsigned char> colors;
+            bool has_colors=!cloud.colors.empty() && cloud.colors.size()==cloud.points.size();
+            float min[3], max[3];
+            valid_points(cloud, has_colors, points, colors, min, max);
+            if(lod>0)
+                decimate(points, colors, has_colors, min, max, config.voxel_size*static_cast<float>(1UL<<(lod-1)));
+
+            size_t count=points.size()/3;
+            float scale[3];
+            for(size_t c=0;c<3;c++)
+                scale[c]=count>0 && max[c]>min[c]?(max[c]-min[c])/65535.0f:0.0f;
+
+            auto frame_id_size=padded(cloud.frame_id.size());
+            auto positions_size=padded(count*3*sizeof(uint16_t));
+            auto colors_size=has_colors?padded(count*3):0;
+            auto size=56+frame_id_size+positions_size+colors_size;
+
+            std::string frame(size, '\0');
+            auto data=reinterpret_cast<unsigned char*>(&frame[0]);
+            put(data, static_cast<uint32_t>(size));
+            std::copy_n("RSPC", 4, data+4);
+            put(data+8, static_cast<uint32_t>(1));
+            put(data+12, static_cast<uint32_t>(sequence));
+            put(data+16, static_cast<uint32_t>(lod));
+            put(data+20, static_cast<uint32_t>(count));
+            put(data+24, static_cast<uint32_t>(has_colors?1:0));
+            for(size_t c=0;c<3;c++) {
+                put(data+28+4*c, count>0?min[c]:0.0f);
+                put(data+40+4*c, scale[c]);
+            }
+            put(data+52, static_cast<uint32_t>(cloud.frame_id.size()));
+            std::copy(cloud.frame_id.begin(), cloud.frame_id.end(), data+56);
+
+            auto positions=data+56+frame_id_size;
+            float inverse_scale[3];
+            for(size_t c=0;c<3;c++)
+                inverse_scale[c]=scale[c]>0.0f?1.0f/scale[c]:0.0f;
+            for(size_t i=0;i<count*3;i++) {
+                auto c=i%3;
+                auto position=static_cast<long>(std::lround((points[i]-min[c])*inverse_scale[c]));
+                put(positions+2*i, static_cast<uint16_t>(std::min(std::max(position, 0L), 65535L)));
+            }
+            if(has_colors)
+                std::copy(colors.begin(), colors.end(), positions+positions_size);
+            return frame;
+        }
+
+    private:
+        ///A frame encoded as an HTTP/1.1 chunk, whose payload is also the frame as written without chunked encoding
+        class Frame {
+        public:
+            Frame(std::string &&payload): payload_size(payload.size()) {
+                char size[20];
+                std::snprintf(size, sizeof(size), "%zx\r\n", payload.size());
+                payload_offset=std::char_traits<char>::length(size);
+                encoded.reserve(payload_offset+payload.size()+2);
+                encoded+=size;
+                encoded+=payload;
+                encoded+="\r\n";
+            }
+
+            std::string encoded;
+            size_t payload_offset, payload_size;
+
+            boost::asio::const_buffer buffer(bool chunked) const {
+                if(chunked)
+                    return boost::asio::buffer(encoded);
+                return boost::asio::buffer(encoded.data()+payload_offset, payload_size);
+            }
+        };
+
+        class Subscriber {
+        public:
+            Subscriber(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response, bool chunked, size_t lod) :
+                    response(response), chunked(chunked), lod(lod), busy(false) {}
+            std::shared_ptr<typename ServerBase<socket_type>::Response> response;
+            bool chunked;
+            size_t lod;
+            ///A write is in progress
+            bool busy;
+            ///The latest frame, if not written yet
+            std::shared_ptr<const Frame> pending;
+            typename std::list<std::shared_ptr<Subscriber> >::iterator position;
+        };
+
+        class Topic {
+        public:
+            Topic(): sequence(0) {}
+            std::mutex mutex;
+            unsigned long sequence;
+            std::shared_ptr<const PointCloud> cloud;
+            ///Frames of cloud that have been encoded, by level of detail
+            std::vector<std::shared_ptr<const Frame> > frames;
+            std::list<std::shared_ptr<Subscriber> > subscribers;
+        };
+
+        const ServerBase<socket_type> &server;
+        std::unordered_map<std::string, std::unique_ptr<Topic> > topics;
+
+        void subscribe(const std::shared_ptr<typename ServerBase<socket_type>::Response> &response,
+                       const std::shared_ptr<typename ServerBase<socket_type>::Request> &request) {
+            auto it=topics.find(request->path_match[1]);
+            if(it==topics.end()) {
+                *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                return;
+            }
+            auto &topic=*it->second;
+            std::string query=request->path_match[2];
+            auto lod=std::min(static_cast<size_t>(std::max(parameter(query, "lod"), 0L)), config.max_lod);
+
+            if(parameter(query, "once")>0 || !server.keep_open(response, request)) {
+                auto frame=latest(topic, lod);
+                if(!frame) {
+                    *response << "HTTP/1.1 204 No Content\r\nCache-Control: no-cache\r\n\r\n";
+                    return;
+                }
+                *response << "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nCache-Control: no-cache\r\nContent-Length: "
+                          << frame->payload_size << "\r\n\r\n";
+                response->write(frame->buffer(false), frame);
+                return;
+            }
+
+            //HTTP/1.1 streams are chunked, so that the connection can be reused once the stream ends
+            bool chunked=request->http_version!="1.0";
+            *response << "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nCache-Control: no-cache\r\n"
+                      << (chunked?"Transfer-Encoding: chunked\r\n":"Connection: close\r\n") << "\r\n";
+
+            auto subscriber=std::make_shared<Subscriber>(response, chunked, lod);
+            std::lock_guard<std::mutex> lock(topic.mutex);
+            subscriber->position=topic.subscribers.emplace(topic.subscribers.end(), subscriber);
+            //Viewers joining at a level of detail that is not encoded yet get the next cloud
+            if(!topic.frames.empty())
+                subscriber->pending=topic.frames[lod];
+            write(topic, subscriber);
+        }
+
+        ///The frame of the latest cloud at level of detail lod, encoded now if no viewer has needed it yet
+        std::shared_ptr<const Frame> latest(Topic &topic, size_t lod) {
+            std::shared_ptr<const PointCloud> cloud;
+            unsigned long sequence;
+            {
+                std::lock_guard<std::mutex> lock(topic.mutex);
+                if(!topic.cloud)
+                    return nullptr;
+                if(topic.frames[lod])
+                    return topic.frames[lod];
+                cloud=topic.cloud;
+                sequence=topic.sequence;
+            }
+            auto frame=std::make_shared<const Frame>(encode(*cloud, lod, sequence));
+            std::lock_guard<std::mutex> lock(topic.mutex);
+            if(topic.sequence==sequence && !topic.frames[lod])
+                topic.frames[lod]=frame;
+            return frame;
+        }
+
+        ///Writes what is buffered in the response and the pending frame at once. Called with topic.mutex locked.
+        void write(Topic &topic, const std::shared_ptr<Subscriber> &subscriber) {
+            subscriber->busy=true;
+            if(subscriber->pending) {
+                subscriber->response->write(subscriber->pending->buffer(subscriber->chunked), subscriber->pending);
+                subscriber->pending=nullptr;
+            }
+            server.send(subscriber->response, [this, &topic, subscriber](const boost::system::error_code &ec) {
+                std::lock_guard<std::mutex> lock(topic.mutex);
+                subscriber->busy=false;
+                if(ec) {
+                    //The viewer is gone; releasing the response ends the connection
+                    topic.subscribers.erase(subscriber->position);
+                    subscriber->response=nullptr;
+                }
+                else if(subscriber->pending)
+                    write(topic, subscriber);
+            });
+        }
+
+        ///Copies the points of cloud with finite coordinates, and finds their bounds
+        static void valid_points(const PointCloud &cloud, bool has_colors, std::vector<float> &points, std::vector<unsigned char> &colors,
+                                 float min[3], float max[3]) {
+            points.reserve(cloud.points.size());
+            if(has_colors)
+                colors.reserve(cloud.colors.size());
+            for(size_t c=0;c<3;c++) {
+                min[c]=HUGE_VALF;
+                max[c]=-HUGE_VALF;
+            }
+            for(size_t i=0;i+2<cloud.points.size();i+=3) {
+                auto point=&cloud.points[i];
+                if(!std::isfinite(point[0]) || !std::isfinite(point[1]) || !std::isfinite(point[2]))
+                    continue;
+                for(size_t c=0;c<3;c++) {
+                    points.emplace_back(point[c]);
+                    min[c]=std::min(min[c], point[c]);
+                    max[c]=std::max(max[c], point[c]);
+                }
+                if(has_colors)
+                    colors.insert(colors.end(), cloud.colors.begin()+static_cast<std::ptrdiff_t>(i), cloud.colors.begin()+static_cast<std::ptrdiff_t>(i+3));
+            }
+        }
+
+        ///Replaces the points in each voxel of edge voxel_size by their centroid, and their colors by the average.
+        ///The points are sorted by voxel with a radix sort, which takes a few passes over the points where hashing
+        ///would take a cache miss per point, and the voxels are kept in that order.
+        static void decimate(std::vector<float> &points, std::vector<unsigned char> &colors, bool has_colors,
+                             const float min[3], const float max[3], float voxel_size) {
+            auto count=points.size()/3;
+            auto inverse_size=1.0f/voxel_size;
+            //Voxel of each point, with as many bits per axis as the extent of the points needs, and at most 21
+            unsigned bits[3];
+            for(size_t c=0;c<3;c++) {
+                auto voxels=std::min(static_cast<uint64_t>((max[c]-min[c])*inverse_size), static_cast<uint64_t>(0x1fffff));
+                for(bits[c]=0;(voxels>>bits[c])>0;bits[c]++) {}
+            }
+            std::vector<std::pair<uint64_t, uint32_t> > keys(count), sorted(count);
+            for(size_t i=0;i<count;i++) {
+                uint64_t key=0;
+                for(size_t c=0;c<3;c++) {
+                    auto voxel=std::min(static_cast<uint64_t>((points[i*3+c]-min[c])*inverse_size), (static_cast<uint64_t>(1)<<bits[c])-1);
+                    key=(key<<bits[c]) | voxel;
+                }
+                keys[i]=std::make_pair(key, static_cast<uint32_t>(i));
+            }
+            for(unsigned shift=0;shift<bits[0]+bits[1]+bits[2];shift+=11) {
+                size_t offsets[2048+1]={0};
+                for(auto &key: keys)
+                    offsets[((key.first>>shift) & 2047)+1]++;
+                for(size_t digit=1;digit<=2048;digit++)
+                    offsets[digit]+=offsets[digit-1];
+                for(auto &key: keys)
+                    sorted[offsets[(key.first>>shift) & 2047]++]=key;
+                keys.swap(sorted);
+            }
+
+            std::vector<float> centroids;
+            std::vector<unsigned char> averages;
+            for(size_t first=0, last;first<count;first=last) {
+                float sum[3]={0.0f, 0.0f, 0.0f};
+                uint32_t color_sum[3]={0, 0, 0};
+                for(last=first;last<count && keys[last].first==keys[first].first;last++) {
+                    auto i=keys[last].second;
+                    for(size_t c=0;c<3;c++) {
+                        sum[c]+=points[i*3+c];
+                        if(has_colors)
+                            color_sum[c]+=colors[i*3+c];
+                    }
+                }
+                auto size=static_cast<uint32_t>(last-first);
+                for(size_t c=0;c<3;c++) {
+                    centroids.emplace_back(sum[c]/static_cast<float>(size));
+                    if(has_colors)
+                        averages.emplace_back(static_cast<unsigned char>((color_sum[c]+size/2)/size));
+                }
+            }
+            points.swap(centroids);
+            colors.swap(averages);
+        }
+
+        static size_t padded(size_t size) {
+            return (size+3)&~static_cast<size_t>(3);
+        }
+
+        static void put(unsigned char *data, uint16_t value) {
+            data[0]=static_cast<unsigned char>(value);
+            data[1]=static_cast<unsigned char>(value>>8);
+        }
+
+        static void put(unsigned char *data, uint32_t value) {
+            for(size_t i=0;i<4;i++)
+                data[i]=static_cast<unsigned char>(value>>(8*i));
+        }
+
+        static void put(unsigned char *data, float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put(data, bits);
+        }
+
+        ///Value of the integer parameter name in query, or 0
+        static long parameter(const std::string &query, const std::string &name) {
+            for(auto position=query.find(name+'=');position!=std::string::npos;position=query.find(name+'=', position+1)) {
+                if(position>0 && (query[position-1]=='?' || query[position-1]=='&'))
+                    return std::atol(query.c_str()+position+name.size()+1);
+            }
+            return 0;
+        }
+    };
+}
+
+#endif	/* POINTCLOUD_HTTP_HPP */
@@ -0,0 +1,271 @@
+#ifndef PROXY_HTTP_HPP
+#define	PROXY_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+#include <rs_web/async_client_http.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <unordered_map>
+#include <list>
+#include <set>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <memory>
+
+namespace SimpleWeb {
+    ///Forwards every request below a path prefix to an upstream HTTP server, for instance the Flask object store.
+    ///Cacheable upstream responses are kept for a short time, and identical concurrent requests are coalesced
+    ///so that only one of them reaches the upstream. Requests with credentials (Authorization or Cookie) are always
+    ///forwarded, and responses that vary on request headers other than those in config.vary are not cached.
+    template <class socket_type>
+    class ReverseProxy {
+    public:
+        class Config {
+            friend class ReverseProxy<socket_type>;
+        private:
+            Config() {}
+        public:
+            /// Seconds an upstream response is served from the cache. Default value: 5 (0 disables caching and coalescing).
+            size_t cache_ttl=5;
+            /// Upper bound on the total size of cached responses in bytes. Default value: 32 MB.
+            size_t cache_max_bytes=32*1024*1024;
+            /// Responses larger than this are passed through but not cached. Default value: 4 MB.
+            size_t cache_max_entry_bytes=4*1024*1024;
+            /// Methods whose responses may be cached. Only add POST if the upstream's POST resources are read-only queries.
+            std::set<std::string> cacheable_methods={"GET", "HEAD"};
+            /// Request headers that are part of the cache key, so that responses varying on them can be cached.
+            std::vector<std::string> vary={"Accept", "Accept-Encoding", "Accept-Language"};
+            /// Methods forwarded to the upstream.
+            std::vector<std::string> methods={"GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH"};
+        };
+
+        /// Set before calling mount
+        Config config;
+
+        ReverseProxy(ServerBase<socket_type> &server, const std::string &upstream_host_port) :
+                server(server), upstream_host_port(upstream_host_port), cache_bytes(0) {}
+
+        ///Adds resources for path_prefix (for instance "/objstore") to the server. Call before server.start().
+        void mount(const std::string &path_prefix) {
+            for(auto &method: config.methods) {
+                server.resource["^"+path_prefix+"([/?].*)?$"][method]=[this, path_prefix]
+                        (std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                         std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                    forward(path_prefix, response, request);
+                };
+            }
+        }
+
+    private:
+        typedef std::function<void(const std::shared_ptr<const std::string>&)> waiter_type;
+
+        class CacheEntry {
+        public:
+            std::string key;
+            std::shared_ptr<const std::string> raw_response;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        ServerBase<socket_type> &server;
+        std::string upstream_host_port;
+
+        std::mutex client_mutex;
+        std::unique_ptr<AsyncClient> client;
+
+        std::mutex cache_mutex;
+        std::list<CacheEntry> lru;
+        std::unordered_map<std::string, typename std::list<CacheEntry>::iterator> cache;
+        size_t cache_bytes;
+        std::unordered_map<std::string, std::vector<waiter_type> > in_flight;
+
+        AsyncClient &get_client() {
+            //The server's io_service does not exist until start(), so the client is created on first use
+            std::lock_guard<std::mutex> lock(client_mutex);
+            if(!client)
+                client=std::unique_ptr<AsyncClient>(new AsyncClient(*server.io_service, upstream_host_port));
+            return *client;
+        }
+
+        static bool is_hop_by_hop(const std::string &field) {
+            static const char *fields[]={"Connection", "Keep-Alive", "Proxy-Authenticate", "Proxy-Authorization",
+                                         "TE", "Trailer", "Transfer-Encoding", "Upgrade", "Content-Length"};
+            for(auto f: fields) {
+                if(boost::iequals(field, f))
+                    return true;
+            }
+            return false;
+        }
+
+        void forward(const std::string &path_prefix, const std::shared_ptr<typename ServerBase<socket_type>::Response> &response,
+                     const std::shared_ptr<typename ServerBase<socket_type>::Request> &request) {
+            std::string upstream_path=request->path_match[1];
+            if(upstream_path.empty() || upstream_path[0]!='/')
+                upstream_path="/"+upstream_path;
+            auto content=request->content.string();
+
+            std::map<std::string, std::string> header;
+            for(auto &h: request->header) {
+                if(!is_hop_by_hop(h.first))
+                    header[h.first]=h.second;
+            }
+            header["X-Forwarded-For"]=request->remote_endpoint_address;
+            header["X-Forwarded-Prefix"]=path_prefix;
+            auto host_it=request->header.find("Host");
+            if(host_it!=request->header.end())
+                header["X-Forwarded-Host"]=host_it->second;
+
+            bool cacheable=config.cache_ttl>0 && config.cacheable_methods.count(request->method)>0 &&
+                           request->header.find("Authorization")==request->header.end() &&
+                           request->header.find("Cookie")==request->header.end();
+            if(!cacheable) {
+                get_client().request(request->method, upstream_path, content, header,
+                                     [this, response, request](const boost::system::error_code &ec, std::shared_ptr<AsyncClient::Response> upstream_response) {
+                    *response << *serialize(ec, upstream_response, request->method=="HEAD", nullptr);
+                });
+                return;
+            }
+
+            auto key=request->method+' '+upstream_path;
+            for(auto &field: config.vary) {
+                key+='\n';
+                auto it=request->header.find(field);
+                if(it!=request->header.end())
+                    key+=it->second;
+            }
+            key+='\n'+content;
+            {
+                std::lock_guard<std::mutex> lock(cache_mutex);
+                auto it=cache.find(key);
+                if(it!=cache.end()) {
+                    if(std::chrono::steady_clock::now()<it->second->expires) {
+                        lru.splice(lru.begin(), lru, it->second);
+                        response->write(it->second->raw_response);
+                        return;
+                    }
+                    cache_bytes-=it->second->raw_response->size();
+                    lru.erase(it->second);
+                    cache.erase(it);
+                }
+                //Coalesce with an identical request that is already on its way to the upstream
+                auto waiter=[response](const std::shared_ptr<const std::string> &raw_response) {
+                    response->write(raw_response);
+                };
+                auto in_flight_it=in_flight.find(key);
+                if(in_flight_it!=in_flight.end()) {
+                    in_flight_it->second.emplace_back(waiter);
+                    return;
+                }
+                in_flight[key].emplace_back(waiter);
+            }
+
+            get_client().request(request->method, upstream_path, content, header,
+                                 [this, key, request](const boost::system::error_code &ec, std::shared_ptr<AsyncClient::Response> upstream_response) {
+                bool store=false;
+                auto raw_response=serialize(ec, upstream_response, request->method=="HEAD", &store);
+                std::vector<waiter_type> waiters;
+                {
+                    std::lock_guard<std::mutex> lock(cache_mutex);
+                    auto it=in_flight.find(key);
+                    if(it!=in_flight.end()) {
+                        waiters=std::move(it->second);
+                        in_flight.erase(it);
+                    }
+                    if(store && raw_response->size()<=config.cache_max_entry_bytes)
+                        insert(key, raw_response);
+                }
+                for(auto &waiter: waiters)
+                    waiter(raw_response);
+            });
+        }
+
+        ///Called with cache_mutex locked. The least recently used entries are evicted to make room.
+        void insert(const std::string &key, const std::shared_ptr<const std::string> &raw_response) {
+            if(raw_response->size()>config.cache_max_bytes)
+                return;
+            auto it=cache.find(key);
+            if(it!=cache.end()) {
+                cache_bytes-=it->second->raw_response->size();
+                lru.erase(it->second);
+                cache.erase(it);
+            }
+            while(!lru.empty() && cache_bytes+raw_response->size()>config.cache_max_bytes) {
+                cache_bytes-=lru.back().raw_response->size();
+                cache.erase(lru.back().key);
+                lru.pop_back();
+            }
+            CacheEntry entry;
+            entry.key=key;
+            entry.raw_response=raw_response;
+            entry.expires=std::chrono::steady_clock::now()+std::chrono::seconds(config.cache_ttl);
+            lru.emplace_front(std::move(entry));
+            cache[key]=lru.begin();
+            cache_bytes+=raw_response->size();
+        }
+
+        ///Whether a Vary header of the upstream only names request headers that are part of the cache key
+        bool is_covered(const std::string &vary) const {
+            size_t start=0;
+            while(start<vary.size()) {
+                auto end=vary.find(',', start);
+                if(end==std::string::npos)
+                    end=vary.size();
+                auto field=vary.substr(start, end-start);
+                boost::algorithm::trim(field);
+                if(!field.empty()) {
+                    bool covered=false;
+                    for(auto &key_field: config.vary) {
+                        if(boost::iequals(field, key_field))
+                            covered=true;
+                    }
+                    if(!covered)
+                        return false;
+                }
+                start=end+1;
+            }
+            return true;
+        }
+
+        ///Builds the complete response for the downstream client. If cacheable is given, it is set to whether the response may be cached.
+        std::shared_ptr<const std::string> serialize(const boost::system::error_code &ec,
+                                                            const std::shared_ptr<AsyncClient::Response> &upstream_response,
+                                                            bool head, bool *cacheable) {
+            std::ostringstream stream;
+            if(ec || !upstream_response) {
+                std::string content="Upstream request failed: "+(ec?ec.message():std::string("no response"));
+                if(ec==boost::asio::error::operation_aborted)
+                    stream << "HTTP/1.1 504 Gateway Timeout\r\n";
+                else
+                    stream << "HTTP/1.1 502 Bad Gateway\r\n";
+                stream << "Content-Length: " << content.length() << "\r\n\r\n" << content;
+                return std::make_shared<const std::string>(stream.str());
+            }
+
+            if(cacheable)
+                *cacheable=upstream_response->status_code.compare(0, 3, "200")==0;
+            stream << "HTTP/1.1 " << upstream_response->status_code << "\r\n";
+            for(auto &h: upstream_response->header) {
+                //A response to HEAD has no content, but keeps the Content-Length of the corresponding GET
+                if(is_hop_by_hop(h.first) && !(head && boost::iequals(h.first, "Content-Length")))
+                    continue;
+                if(cacheable) {
+                    if(boost::iequals(h.first, "Set-Cookie") ||
+                       (boost::iequals(h.first, "Cache-Control") &&
+                        (boost::icontains(h.second, "no-store") || boost::icontains(h.second, "private") || boost::icontains(h.second, "no-cache"))) ||
+                       (boost::iequals(h.first, "Vary") && !is_covered(h.second)))
+                        *cacheable=false;
+                }
+                stream << h.first << ": " << h.second << "\r\n";
+            }
+            if(!head)
+                stream << "Content-Length: " << upstream_response->content.size() << "\r\n";
+            stream << "\r\n" << upstream_response->content;
+            return std::make_shared<const std::string>(stream.str());
+        }
+    };
+}
+
+#endif	/* PROXY_HTTP_HPP */
@@ -0,0 +1,135 @@
+#ifndef RATE_LIMIT_HTTP_HPP
+#define	RATE_LIMIT_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+
+namespace SimpleWeb {
+    ///Filter (see middleware_http.hpp) limiting each client to rate requests per second with bursts of up to burst
+    ///requests, using token buckets. Clients are identified by the value of key_header, or by their remote address
+    ///if key_header is empty or missing from the request. Requests over the limit are answered with
+    ///429 Too Many Requests and a Retry-After header.
+    ///
+    ///The buckets are kept in a table of fixed size, so memory stays bounded however many clients there are.
+    ///A client whose bucket has refilled is indistinguishable from a new one, and its slot is reused first;
+    ///when the table is full of active clients, the least recently seen one is evicted.
+    ///Copies share the same table, so one RateLimit can be attached to several resources to limit them together.
+    class RateLimit {
+    public:
+        ///Throws std::invalid_argument if rate is not positive, since a bucket would then never refill
+        RateLimit(double rate, double burst, const std::string &key_header="", size_t max_clients=65536) :
+                key_header(key_header), table(std::make_shared<Table>(rate, burst, max_clients)) {}
+
+        template<class Response, class Request, class Next>
+        void operator()(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request, const Next &next) const {
+            const std::string *key=&request->remote_endpoint_address;
+            if(!key_header.empty()) {
+                auto it=request->header.find(key_header);
+                if(it!=request->header.end())
+                    key=&it->second;
+            }
+            double retry_after;
+            if(table->acquire(std::hash<std::string>()(*key), retry_after)) {
+                next(response, request);
+                return;
+            }
+            *response << "HTTP/1.1 429 Too Many Requests\r\nRetry-After: " << static_cast<unsigned long>(std::ceil(std::max(retry_after, 1.0)))
+                      << "\r\nContent-Length: 0\r\n\r\n";
+        }
+
+    private:
+        class Bucket {
+        public:
+            Bucket(): key(0), last(0), tokens(0) {}
+            uint64_t key;
+            int64_t last;
+            double tokens;
+        };
+
+        class Shard {
+        public:
+            Shard(size_t size): buckets(size) {
+                lock.clear();
+            }
+            std::atomic_flag lock;
+            std::vector<Bucket> buckets;
+            char padding[64];
+        };
+
+        class Table {
+        public:
+            Table(double rate, double burst, size_t max_clients): rate(rate), burst(std::max(burst, 1.0)) {
+                if(!(rate>0.0))
+                    throw std::invalid_argument("RateLimit: rate must be positive");
+                size_t slots=probe_length;
+                while(slots*num_shards<max_clients)
+                    slots<<=1;
+                mask=slots-1;
+                for(size_t c=0;c<num_shards;c++)
+                    shards.emplace_back(new Shard(slots));
+            }
+
+            ///Takes a token from the bucket of key, or returns false with the seconds until one is available
+            bool acquire(size_t hash, double &retry_after) {
+                auto now=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                uint64_t key=static_cast<uint64_t>(hash)|1;
+                auto &shard=*shards[hash%num_shards];
+                auto index=(hash/num_shards)&mask;
+
+                while(shard.lock.test_and_set(std::memory_order_acquire)) {}
+                Bucket *bucket=nullptr, *replace=nullptr;
+                for(size_t c=0;c<probe_length;c++) {
+                    auto &candidate=shard.buckets[(index+c)&mask];
+                    if(candidate.key==key) {
+                        bucket=&candidate;
+                        break;
+                    }
+                    if(!replace || refilled(candidate, now) || (!refilled(*replace, now) && candidate.last<replace->last))
+                        replace=&candidate;
+                }
+                if(!bucket) {
+                    bucket=replace;
+                    bucket->key=key;
+                    bucket->tokens=burst;
+                }
+                else
+                    bucket->tokens=std::min(burst, bucket->tokens+static_cast<double>(now-bucket->last)*rate/1e9);
+                bucket->last=now;
+
+                bool acquired=bucket->tokens>=1.0;
+                if(acquired)
+                    bucket->tokens-=1.0;
+                else
+                    retry_after=(1.0-bucket->tokens)/rate;
+                shard.lock.clear(std::memory_order_release);
+                return acquired;
+            }
+
+        private:
+            static const size_t num_shards=64;
+            static const size_t probe_length=8;
+            const double rate, burst;
+            size_t mask;
+            std::vector<std::unique_ptr<Shard> > shards;
+
+            bool refilled(const Bucket &bucket, int64_t now) const {
+                return bucket.key==0 || bucket.tokens+static_cast<double>(now-bucket.last)*rate/1e9>=burst;
+            }
+        };
+
+        std::string key_header;
+        std::shared_ptr<Table> table;
+    };
+}
+
+#endif	/* RATE_LIMIT_HTTP_HPP */
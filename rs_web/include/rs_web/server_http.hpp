@@ -27,15 +27,24 @@ SOFTWARE.
 #define	SERVER_HTTP_HPP
 
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/functional/hash.hpp>
 
 #include <unordered_map>
 #include <thread>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 #include <functional>
 #include <iostream>
 #include <sstream>
 
+#include <unistd.h>
+#include <sys/stat.h>
+
 // Late 2017 TODO: remove the following checks and always use std::regex
 #ifdef USE_BOOST_REGEX
 #include <boost/regex.hpp>
@@ -48,6 +57,8 @@ SOFTWARE.
 namespace SimpleWeb {
     template <class socket_type>
     class ServerBase {
+    protected:
+        class Timeout;
     public:
         virtual ~ServerBase() {}
 
@@ -58,11 +69,57 @@ namespace SimpleWeb {
 
             std::shared_ptr<socket_type> socket;
 
-            Response(const std::shared_ptr<socket_type> &socket): std::ostream(&streambuf), socket(socket) {}
+            unsigned short status_code;
+            size_t bytes_sent;
+
+            ///Deadline of the response, lifted by keep_open()
+            std::shared_ptr<Timeout> timeout;
+            bool kept_open;
+
+            ///Memory sent after the first stream_offset bytes of streambuf, without being copied into it
+            class Segment {
+            public:
+                Segment(size_t stream_offset, const boost::asio::const_buffer &buffer, const std::shared_ptr<const void> &owner) :
+                        stream_offset(stream_offset), buffer(buffer), owner(owner) {}
+                size_t stream_offset;
+                boost::asio::const_buffer buffer;
+                std::shared_ptr<const void> owner;
+            };
+            std::vector<Segment> segments;
+            size_t segment_bytes;
+
+            Response(const std::shared_ptr<socket_type> &socket) :
+                    std::ostream(&streambuf), socket(socket), status_code(0), bytes_sent(0), kept_open(false), segment_bytes(0),
+                    close_connection_after_response(false) {}
 
         public:
+            ///Set to close the connection once the response has been sent, instead of reading the next request.
+            ///For instance when the content turns out shorter than the Content-Length that was sent.
+            bool close_connection_after_response;
+
             size_t size() {
-                return streambuf.size();
+                return streambuf.size()+segment_bytes;
+            }
+
+            using std::ostream::write;
+
+            ///Appends buffer to the response without copying it, after what has been written to the stream so far.
+            ///owner keeps the memory of buffer alive until it has been sent. Detached responses copy buffer.
+            void write(const boost::asio::const_buffer &buffer, const std::shared_ptr<const void> &owner) {
+                auto buffer_size=boost::asio::buffer_size(buffer);
+                if(buffer_size==0)
+                    return;
+                if(!socket) {
+                    write(boost::asio::buffer_cast<const char*>(buffer), static_cast<std::streamsize>(buffer_size));
+                    return;
+                }
+                segments.emplace_back(streambuf.size(), buffer, owner);
+                segment_bytes+=buffer_size;
+            }
+
+            ///Appends data to the response without copying it
+            void write(const std::shared_ptr<const std::string> &data) {
+                write(boost::asio::buffer(*data), data);
             }
         };
         
@@ -112,25 +169,70 @@ namespace SimpleWeb {
             
             std::string remote_endpoint_address;
             unsigned short remote_endpoint_port;
+
+            ///Path regex of the matched entry in ServerBase::resource, or nullptr if a default_resource was used
+            const std::string *resource_path;
+
+            ///Points in time at which the request passed each processing phase
+            class Trace {
+            public:
+                std::chrono::steady_clock::time_point read_start, header_read, parsed, content_read, resource_found,
+                                                      handler_returned, response_released, response_written;
+            };
+            ///Only set for requests sampled by ServerBase::trace_sampler
+            std::unique_ptr<Trace> trace;
             
         private:
-            Request(): content(streambuf) {}
+            Request(): content(streambuf), resource_path(nullptr), header_error(nullptr) {}
             
             boost::asio::streambuf streambuf;
+
+            std::chrono::steady_clock::time_point header_time;
+
+            ///Holds the request's share of the in-flight and buffered-bytes limits until the request is destroyed
+            std::shared_ptr<size_t> admission;
+
+            ///Status to answer with if the header exceeds a limit while being read
+            const char *header_error;
         };
         
         class Config {
             friend class ServerBase<socket_type>;
 
-            Config(unsigned short port, size_t num_threads): num_threads(num_threads), port(port), reuse_address(true) {}
+            Config(unsigned short port, size_t num_threads): num_threads(num_threads), port(port), reuse_address(true),
+                    max_connections(0), max_requests(0), max_buffered_bytes(0), latency_target(0),
+                    max_request_line(8192), max_header_count(100), max_header_bytes(32768), min_transfer_rate(0) {}
             size_t num_threads;
         public:
             unsigned short port;
             ///IPv4 address in dotted decimal form or IPv6 address in hexadecimal notation.
             ///If empty, the address will be any address.
+            ///For Server<UnixStream>, the path of the socket, or @name for a name in the abstract namespace.
             std::string address;
             ///Set to false to avoid binding the socket to an address that is already in use.
             bool reuse_address;
+            ///Maximum number of open connections. Accepting is paused while it is reached. Connections held by a response
+            ///passed to keep_open(), such as event streams, are not counted, since they only cost memory. 0: no limit.
+            size_t max_connections;
+            ///Maximum number of requests being processed. Further requests are answered with 503. 0: no limit.
+            size_t max_requests;
+            ///Maximum number of bytes held by requests being processed and responses being written. While exceeded,
+            ///new requests are answered with 503 and accepting is paused. 0: no limit.
+            size_t max_buffered_bytes;
+            ///Request latency in milliseconds, from received header to released response, that the server aims to stay below.
+            ///If non-zero, the number of concurrent requests is limited adaptively (additive increase while latency is below
+            ///the target, multiplicative decrease above), and requests beyond the limit are answered with 503.
+            size_t latency_target;
+            ///Longest request line accepted, in bytes. Longer request lines are answered with 414.
+            size_t max_request_line;
+            ///Most header fields accepted in a request. More are answered with 431.
+            size_t max_header_count;
+            ///Largest request header accepted, in bytes, including the request line. Larger headers are answered with 431.
+            ///A connection never buffers more than this plus one socket read (64 KB) before its header is complete.
+            size_t max_header_bytes;
+            ///Lowest average transfer rate in bytes per second, measured from the first byte of a request header,
+            ///request content or response write. Slower requests are answered with 408, slower responses are abandoned. 0: no minimum.
+            size_t min_transfer_rate;
         };
         ///Set before calling start().
         Config config;
@@ -143,9 +245,30 @@ namespace SimpleWeb {
         
         std::function<void(const std::exception&)> exception_handler;
 
+        ///Called after each response has been written, with its status code, the number of bytes written
+        ///and the time since the request header was received. Set before calling start().
+        std::function<void(const Request&, unsigned short status_code, size_t bytes, std::chrono::steady_clock::duration latency)> on_response;
+
+        ///Decides whether a request is traced; should be cheap, since it is called for every request. Set before calling start().
+        std::function<bool()> trace_sampler;
+        ///Called after the response of a traced request has been written.
+        std::function<void(const Request&)> on_trace;
+
+        ///Called before a request is passed to a resource function. Returns true to take over the connection,
+        ///for instance for a request asking to switch to HTTP/2. Set before calling start().
+        std::function<bool(const std::shared_ptr<socket_type>&, const std::shared_ptr<Request>&)> on_upgrade;
+
     private:
-        std::vector<std::pair<std::string, std::vector<std::pair<REGEX_NS::regex,
-            std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>, std::shared_ptr<typename ServerBase<socket_type>::Request>)> > > > > opt_resource;
+        class OptResource {
+        public:
+            OptResource(const std::string &path, const std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>,
+                                                                          std::shared_ptr<typename ServerBase<socket_type>::Request>)> &function) :
+                    path(&path), regex(path), function(function) {}
+            const std::string *path;
+            REGEX_NS::regex regex;
+            std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>, std::shared_ptr<typename ServerBase<socket_type>::Request>)> function;
+        };
+        std::vector<std::pair<std::string, std::vector<OptResource> > > opt_resource;
         
     public:
         void start() {
@@ -165,7 +288,7 @@ namespace SimpleWeb {
                         it=opt_resource.begin()+(opt_resource.size()-1);
                         it->first=res_method.first;
                     }
-                    it->second.emplace_back(REGEX_NS::regex(res.first), res_method.second);
+                    it->second.emplace_back(res.first, res_method.second);
                 }
             }
 
@@ -175,14 +298,10 @@ namespace SimpleWeb {
             if(io_service->stopped())
                 io_service->reset();
 
-            boost::asio::ip::tcp::endpoint endpoint;
-            if(config.address.size()>0)
-                endpoint=boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(config.address), config.port);
-            else
-                endpoint=boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), config.port);
+            auto endpoint=listen_endpoint();
             
             if(!acceptor)
-                acceptor=std::unique_ptr<boost::asio::ip::tcp::acceptor>(new boost::asio::ip::tcp::acceptor(*io_service));
+                acceptor=std::unique_ptr<typename protocol_type::acceptor>(new typename protocol_type::acceptor(*io_service));
             acceptor->open(endpoint.protocol());
             acceptor->set_option(boost::asio::socket_base::reuse_address(config.reuse_address));
             acceptor->bind(endpoint);
@@ -214,52 +333,420 @@ namespace SimpleWeb {
                 io_service->stop();
         }
         
-        ///Use this function if you need to recursively send parts of a longer message
+        ///Use this function if you need to recursively send parts of a longer message.
+        ///What has been written to the stream and the segments added with Response::write(buffer, owner) go out in one gather write.
         void send(const std::shared_ptr<Response> &response, const std::function<void(const boost::system::error_code&)>& callback=nullptr) const {
-            boost::asio::async_write(*response->socket, response->streambuf, [this, response, callback](const boost::system::error_code& ec, size_t /*bytes_transferred*/) {
+            record_status(*response);
+            response->bytes_sent+=response->size();
+
+            //A detached response keeps everything in its buffer until it is released
+            if(!response->socket) {
+                if(callback)
+                    io_service->post([callback] {
+                        callback(boost::system::error_code());
+                    });
+                return;
+            }
+
+            //Segments are shared rather than held by the response, so only the stream counts toward config.max_buffered_bytes
+            auto buffered=response->streambuf.size();
+            auto data=boost::asio::buffer_cast<const char*>(response->streambuf.data());
+            auto segments=std::make_shared<std::vector<typename Response::Segment> >();
+            segments->swap(response->segments);
+            response->segment_bytes=0;
+            std::vector<boost::asio::const_buffer> buffers;
+            buffers.reserve(segments->size()*2+1);
+            size_t offset=0;
+            for(auto &segment: *segments) {
+                if(segment.stream_offset>offset)
+                    buffers.emplace_back(data+offset, segment.stream_offset-offset);
+                offset=segment.stream_offset;
+                buffers.emplace_back(segment.buffer);
+            }
+            if(buffered>offset)
+                buffers.emplace_back(data+offset, buffered-offset);
+
+            buffered_bytes+=buffered;
+            //The deadline of the whole response is set in write_response(), this only enforces the transfer rate
+            auto timeout=config.min_transfer_rate>0?get_timeout(response->socket, timeout_content, nullptr):nullptr;
+            if(timeout)
+                timeout->transferred(0);
+            boost::asio::async_write(*response->socket, buffers, [timeout](const boost::system::error_code &ec, size_t bytes_transferred) -> size_t {
+                if(timeout)
+                    timeout->transferred(bytes_transferred);
+                return ec?0:65536;
+            }, [this, response, callback, buffered, segments, timeout](const boost::system::error_code& ec, size_t /*bytes_transferred*/) {
+                if(timeout)
+                    timeout->cancel();
+                response->streambuf.consume(buffered);
+                buffered_bytes-=buffered;
+                resume_accept();
                 if(callback)
                     callback(ec);
             });
         }
 
+        ///Keeps the connection of response open for as long as the response is held, instead of closing it after
+        ///timeout_content, for responses written in parts as events occur. The request no longer counts as in flight,
+        ///and the connection no longer counts toward config.max_connections until the response is released.
+        ///Returns false if response is detached, in which case nothing is written before it is released.
+        bool keep_open(const std::shared_ptr<Response> &response, const std::shared_ptr<Request> &request) const {
+            if(!response->socket)
+                return false;
+            if(response->kept_open)
+                return true;
+            if(response->timeout && !response->timeout->cancel())
+                return false;
+            response->kept_open=true;
+            request->admission=nullptr;
+            connections--;
+            resume_accept();
+            return true;
+        }
+
+        ///Creates a Response that is not attached to a connection, for instance to capture the output of a resource function.
+        ///on_complete is called with the Response once the last reference to it is released.
+        std::shared_ptr<Response> create_detached_response(const std::function<void(Response&)> &on_complete) const {
+            return std::shared_ptr<Response>(new Response(nullptr), [on_complete](Response *response_ptr) {
+                std::unique_ptr<Response> response(response_ptr);
+                on_complete(*response);
+            });
+        }
+
+        ///Creates a Request that is not read from a connection, for other protocols to fill in.
+        ///Its content is written through request->content.rdbuf().
+        std::shared_ptr<Request> create_request() const {
+            return std::shared_ptr<Request>(new Request());
+        }
+
+        ///Reserves an in-flight slot and the buffer space of request, or returns false if the server is overloaded.
+        ///Protocols that receive the content of a request in parts admit it on its header, and reserve() the rest.
+        bool admit(const std::shared_ptr<Request> &request, size_t content_length) {
+            auto bytes=request->streambuf.size()+content_length;
+            if(config.max_buffered_bytes>0 && buffered_bytes+bytes>config.max_buffered_bytes)
+                return false;
+            size_t limit=config.max_requests;
+            if(config.latency_target>0) {
+                auto adaptive_limit=current_concurrency_limit.load(std::memory_order_relaxed);
+                limit=limit>0?std::min(limit, adaptive_limit):adaptive_limit;
+            }
+            auto in_flight=++requests_in_flight;
+            if(limit>0 && in_flight>limit) {
+                requests_in_flight--;
+                return false;
+            }
+            buffered_bytes+=bytes;
+            request->admission=std::shared_ptr<size_t>(new size_t(bytes), [this](size_t *admitted_bytes) {
+                requests_in_flight--;
+                buffered_bytes-=*admitted_bytes;
+                delete admitted_bytes;
+                resume_accept();
+            });
+            return true;
+        }
+
+        ///Adds bytes to the buffer space held by an admitted request, or returns false if that would exceed config.max_buffered_bytes
+        bool reserve(const std::shared_ptr<Request> &request, size_t bytes) {
+            if(!request->admission || (config.max_buffered_bytes>0 && buffered_bytes+bytes>config.max_buffered_bytes))
+                return false;
+            *request->admission+=bytes;
+            buffered_bytes+=bytes;
+            return true;
+        }
+
+        ///Passes request and response to the matching resource function or default resource function, subject to
+        ///the same admission limits as requests read by the server, unless request has been admitted already.
+        ///Returns false if no resource function matches.
+        bool dispatch(const std::shared_ptr<Request> &request, const std::shared_ptr<Response> &response) {
+            auto resource_function=match_resource(*request);
+            if(!resource_function)
+                return false;
+            if(!request->admission && !admit(request, 0)) {
+                *response << "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n";
+                return true;
+            }
+            request->header_time=std::chrono::steady_clock::now();
+            try {
+                (*resource_function)(response, request);
+            }
+            catch(const std::exception &e) {
+                if(exception_handler)
+                    exception_handler(e);
+            }
+            return true;
+        }
+
+        ///Seconds a request header may take to arrive. 0: no limit.
+        long request_timeout() const {
+            return timeout_request;
+        }
+
+        ///Seconds request content may take to arrive, and a response to be written. 0: no limit.
+        long content_timeout() const {
+            return timeout_content;
+        }
+
         /// If you have your own boost::asio::io_service, store its pointer here before running start().
         /// You might also want to set config.num_threads to 0.
         std::shared_ptr<boost::asio::io_service> io_service;
     protected:
-        std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor;
+        typedef typename socket_type::lowest_layer_type::protocol_type protocol_type;
+
+        std::unique_ptr<typename protocol_type::acceptor> acceptor;
         std::vector<std::thread> threads;
         
         long timeout_request;
         long timeout_content;
+
+        mutable std::atomic<size_t> connections;
+        std::atomic<size_t> requests_in_flight;
+        mutable std::atomic<size_t> buffered_bytes;
+        mutable std::atomic<bool> accept_paused;
+
+        static constexpr double initial_concurrency_limit=16.0;
+        std::mutex concurrency_mutex;
+        double concurrency_limit;
+        size_t concurrency_window;
+        bool concurrency_decreased;
+        std::atomic<size_t> current_concurrency_limit;
         
         ServerBase(unsigned short port, size_t num_threads, long timeout_request, long timeout_send_or_receive) :
-                config(port, num_threads), timeout_request(timeout_request), timeout_content(timeout_send_or_receive) {}
+                config(port, num_threads), timeout_request(timeout_request), timeout_content(timeout_send_or_receive),
+                connections(0), requests_in_flight(0), buffered_bytes(0), accept_paused(false),
+                concurrency_limit(initial_concurrency_limit), concurrency_window(0), concurrency_decreased(false),
+                current_concurrency_limit(initial_concurrency_limit) {}
         
         virtual void accept()=0;
+
+        ///Endpoint for the acceptor to bind to, from config
+        virtual typename protocol_type::endpoint listen_endpoint()=0;
+
+        ///Creates a socket that is counted in connections until it is destroyed
+        template<class... Args>
+        std::shared_ptr<socket_type> create_socket(Args&&... args) {
+            connections++;
+            return std::shared_ptr<socket_type>(new socket_type(std::forward<Args>(args)...), [this](socket_type *socket) {
+                delete socket;
+                connections--;
+                resume_accept();
+            });
+        }
+
+        bool accept_allowed() const {
+            return (config.max_connections==0 || connections<config.max_connections) &&
+                   (config.max_buffered_bytes==0 || buffered_bytes<=config.max_buffered_bytes);
+        }
+
+        ///Called by accept() when a connection has been accepted: continues accepting, or pauses until the limits allow it
+        void accept_next() {
+            if(accept_allowed()) {
+                accept();
+                return;
+            }
+            accept_paused=true;
+            //A connection might have closed before the flag was set
+            resume_accept();
+        }
+
+        void resume_accept() const {
+            if(!accept_paused.load(std::memory_order_relaxed) || !accept_allowed())
+                return;
+            bool paused=true;
+            if(accept_paused.compare_exchange_strong(paused, false)) {
+                auto self=const_cast<ServerBase<socket_type>*>(this);
+                io_service->post([self] {
+                    if(self->acceptor && self->acceptor->is_open())
+                        self->accept();
+                });
+            }
+        }
+
+        ///AIMD: the limit grows by about one per window of limit requests completed below config.latency_target,
+        ///and is reduced by a tenth at most once per window when latency exceeds it
+        void update_concurrency_limit(std::chrono::steady_clock::duration latency) {
+            if(config.latency_target==0)
+                return;
+            std::lock_guard<std::mutex> lock(concurrency_mutex);
+            if(latency>std::chrono::milliseconds(config.latency_target)) {
+                if(!concurrency_decreased) {
+                    concurrency_limit=std::max(1.0, concurrency_limit*0.9);
+                    concurrency_decreased=true;
+                }
+            }
+            else
+                concurrency_limit+=1.0/concurrency_limit;
+            if(config.max_requests>0)
+                concurrency_limit=std::min(concurrency_limit, static_cast<double>(config.max_requests));
+            if(++concurrency_window>=concurrency_limit) {
+                concurrency_window=0;
+                concurrency_decreased=false;
+            }
+            current_concurrency_limit.store(static_cast<size_t>(concurrency_limit), std::memory_order_relaxed);
+        }
+
+        ///Writes a response without content, and closes the connection since the rest of the request is not read.
+        ///Retry-After is only sent when retry_after is set, for rejections that a retry can get past.
+        void reject(const std::shared_ptr<socket_type> &socket, const std::string &status, bool retry_after=false) const {
+            auto response=std::make_shared<std::string>("HTTP/1.1 "+status+(retry_after?"\r\nRetry-After: 1":"")+
+                                                        "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            auto timeout=get_timeout(socket, timeout_request, nullptr);
+            boost::asio::async_write(*socket, boost::asio::buffer(*response), [socket, response, timeout](const boost::system::error_code&, size_t) {
+                if(timeout)
+                    timeout->cancel();
+                boost::system::error_code ec;
+                socket->lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+                socket->lowest_layer().close(ec);
+            });
+        }
         
-        std::shared_ptr<boost::asio::deadline_timer> get_timeout_timer(const std::shared_ptr<socket_type> &socket, long seconds) {
+        ///Deadline of a read or write phase, that also enforces config.min_transfer_rate when the phase reports its progress
+        class Timeout {
+            friend class ServerBase<socket_type>;
+
+            boost::asio::steady_timer timer;
+            std::chrono::steady_clock::time_point deadline;
+            std::atomic<std::chrono::steady_clock::rep> first_byte;
+            std::atomic<size_t> bytes;
+            std::atomic<bool> done;
+
+            Timeout(boost::asio::io_service &io_service): timer(io_service), first_byte(0), bytes(0), done(false) {}
+
+        public:
+            ///Reports the number of bytes transferred so far in this phase
+            void transferred(size_t total) {
+                bytes.store(total, std::memory_order_relaxed);
+                if(first_byte.load(std::memory_order_relaxed)==0)
+                    first_byte.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            }
+
+            ///Stops the timeout. Returns false if it has expired already, in which case the connection is being closed.
+            bool cancel() {
+                if(done.exchange(true))
+                    return false;
+                boost::system::error_code ec;
+                timer.cancel(ec);
+                return true;
+            }
+        };
+
+        ///Closes socket after seconds, or earlier if the phase falls below config.min_transfer_rate.
+        ///If timeout_status is given, and the phase has started transferring, the client is answered with timeout_status first.
+        std::shared_ptr<Timeout> get_timeout(const std::shared_ptr<socket_type> &socket, long seconds, const char *timeout_status) const {
             if(seconds==0)
                 return nullptr;
-            
-            auto timer=std::make_shared<boost::asio::deadline_timer>(*io_service);
-            timer->expires_from_now(boost::posix_time::seconds(seconds));
-            timer->async_wait([socket](const boost::system::error_code& ec){
-                if(!ec) {
+
+            auto timeout=std::shared_ptr<Timeout>(new Timeout(*io_service));
+            timeout->deadline=std::chrono::steady_clock::now()+std::chrono::seconds(seconds);
+            wait_timeout(timeout, socket, timeout_status);
+            return timeout;
+        }
+
+        void wait_timeout(const std::shared_ptr<Timeout> &timeout, const std::shared_ptr<socket_type> &socket, const char *timeout_status) const {
+            //Without a minimum transfer rate, only the deadline needs to be waited for
+            auto next=timeout->deadline;
+            if(config.min_transfer_rate>0)
+                next=std::min(next, std::chrono::steady_clock::now()+std::chrono::seconds(1));
+            timeout->timer.expires_at(next);
+            timeout->timer.async_wait([this, timeout, socket, timeout_status](const boost::system::error_code& ec) {
+                if(ec || timeout->done.load())
+                    return;
+                auto now=std::chrono::steady_clock::now();
+                if(now<timeout->deadline && !too_slow(*timeout, now)) {
+                    wait_timeout(timeout, socket, timeout_status);
+                    return;
+                }
+                if(timeout->done.exchange(true))
+                    return;
+                if(timeout_status && timeout->first_byte.load()!=0)
+                    reject(socket, timeout_status);
+                else {
                     boost::system::error_code ec;
                     socket->lowest_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
-                    socket->lowest_layer().close();
+                    socket->lowest_layer().close(ec);
                 }
             });
-            return timer;
         }
+
+        bool too_slow(const Timeout &timeout, std::chrono::steady_clock::time_point now) const {
+            auto first_byte=timeout.first_byte.load(std::memory_order_relaxed);
+            if(config.min_transfer_rate==0 || first_byte==0)
+                return false;
+            auto elapsed=std::chrono::duration<double>(now-std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(first_byte))).count();
+            return elapsed>=1.0 && static_cast<double>(timeout.bytes.load(std::memory_order_relaxed))<elapsed*config.min_transfer_rate;
+        }
+
+        ///Sets response.status_code from the status line, once it has been written to the stream or as the first segment
+        void record_status(Response &response) const {
+            if(response.status_code!=0)
+                return;
+            const char *data=nullptr;
+            if(response.streambuf.size()>=12 && (response.segments.empty() || response.segments.front().stream_offset>=12))
+                data=boost::asio::buffer_cast<const char*>(response.streambuf.data());
+            else if(response.streambuf.size()==0 && !response.segments.empty() && boost::asio::buffer_size(response.segments.front().buffer)>=12)
+                data=boost::asio::buffer_cast<const char*>(response.segments.front().buffer);
+            //Status line starts with "HTTP/1.1 200"
+            if(data && data[9]>='0' && data[9]<='9' && data[10]>='0' && data[10]<='9' && data[11]>='0' && data[11]<='9')
+                response.status_code=static_cast<unsigned short>((data[9]-'0')*100+(data[10]-'0')*10+(data[11]-'0'));
+        }
+
+        ///Match condition for async_read_until() that finds the end of the request header, and stops reading
+        ///with an error status when the header exceeds the configured limits
+        class HeaderEnd {
+        public:
+            typedef boost::asio::buffers_iterator<boost::asio::streambuf::const_buffers_type> iterator;
+            typedef std::pair<iterator, bool> result_type;
+
+            HeaderEnd(const Config &config, Timeout *timeout, const char **error) :
+                    config(config), timeout(timeout), error(error), bytes(0), line_length(0), lines(0), carriage_return(false) {}
+
+            result_type operator()(iterator begin, iterator end) {
+                for(auto it=begin;it!=end;) {
+                    auto c=*it++;
+                    bytes++;
+                    if(c=='\n' && carriage_return) {
+                        if(line_length==1 && lines>0)
+                            return result_type(it, true);
+                        if(++lines>config.max_header_count+1) {
+                            *error="431 Request Header Fields Too Large";
+                            return result_type(it, true);
+                        }
+                        line_length=0;
+                    }
+                    else
+                        line_length++;
+                    carriage_return=c=='\r';
+                    if(lines==0 && line_length>config.max_request_line+1) {
+                        *error="414 URI Too Long";
+                        return result_type(it, true);
+                    }
+                    if(bytes>config.max_header_bytes) {
+                        *error="431 Request Header Fields Too Large";
+                        return result_type(it, true);
+                    }
+                }
+                if(timeout && bytes>0)
+                    timeout->transferred(bytes);
+                return result_type(end, false);
+            }
+
+        private:
+            const Config &config;
+            Timeout *timeout;
+            const char **error;
+            size_t bytes, line_length, lines;
+            bool carriage_return;
+        };
         
         void read_request_and_content(const std::shared_ptr<socket_type> &socket) {
             //Create new streambuf (Request::streambuf) for async_read_until()
             //shared_ptr is used to pass temporary objects to the asynchronous functions
             std::shared_ptr<Request> request(new Request());
+            if(trace_sampler && trace_sampler()) {
+                request->trace=std::unique_ptr<typename Request::Trace>(new typename Request::Trace());
+                request->trace->read_start=std::chrono::steady_clock::now();
+            }
             try {
-                request->remote_endpoint_address=socket->lowest_layer().remote_endpoint().address().to_string();
-                request->remote_endpoint_port=socket->lowest_layer().remote_endpoint().port();
+                set_remote_endpoint(*request, socket->lowest_layer().remote_endpoint());
             }
             catch(const std::exception &e) {
                 if(exception_handler)
@@ -267,13 +754,20 @@ namespace SimpleWeb {
             }
 
             //Set timeout on the following boost::asio::async-read or write function
-            auto timer=get_timeout_timer(socket, timeout_request);
+            auto timeout=get_timeout(socket, timeout_request, "408 Request Timeout");
                         
-            boost::asio::async_read_until(*socket, request->streambuf, "\r\n\r\n",
-                    [this, socket, request, timer](const boost::system::error_code& ec, size_t bytes_transferred) {
-                if(timer)
-                    timer->cancel();
+            boost::asio::async_read_until(*socket, request->streambuf, HeaderEnd(config, timeout.get(), &request->header_error),
+                    [this, socket, request, timeout](const boost::system::error_code& ec, size_t bytes_transferred) {
+                if(timeout && !timeout->cancel())
+                    return;
+                if(!ec && request->header_error) {
+                    reject(socket, request->header_error);
+                    return;
+                }
                 if(!ec) {
+                    request->header_time=std::chrono::steady_clock::now();
+                    if(request->trace)
+                        request->trace->header_read=request->header_time;
                     //request->streambuf.size() is not necessarily the same as bytes_transferred, from Boost-docs:
                     //"After a successful async_read_until operation, the streambuf may contain additional data beyond the delimiter"
                     //The chosen solution is to extract lines from the stream directly when parsing the header. What is left of the
@@ -282,11 +776,12 @@ namespace SimpleWeb {
                     
                     if(!parse_request(request))
                         return;
+                    if(request->trace)
+                        request->trace->parsed=std::chrono::steady_clock::now();
                     
-                    //If content, read that as well
+                    unsigned long long content_length=0;
                     auto it=request->header.find("Content-Length");
                     if(it!=request->header.end()) {
-                        unsigned long long content_length;
                         try {
                             content_length=stoull(it->second);
                         }
@@ -295,15 +790,32 @@ namespace SimpleWeb {
                                 exception_handler(e);
                             return;
                         }
+                    }
+
+                    //Shed load before reading the content
+                    if(!admit(request, content_length>num_additional_bytes?content_length-num_additional_bytes:0)) {
+                        reject(socket, "503 Service Unavailable", true);
+                        return;
+                    }
+
+                    //If content, read that as well
+                    if(it!=request->header.end()) {
                         if(content_length>num_additional_bytes) {
                             //Set timeout on the following boost::asio::async-read or write function
-                            auto timer=get_timeout_timer(socket, timeout_content);
+                            auto timeout=get_timeout(socket, timeout_content, "408 Request Timeout");
+                            if(timeout)
+                                timeout->transferred(0);
+                            auto remaining=content_length-num_additional_bytes;
                             boost::asio::async_read(*socket, request->streambuf,
-                                    boost::asio::transfer_exactly(content_length-num_additional_bytes),
-                                    [this, socket, request, timer]
+                                    [timeout, remaining](const boost::system::error_code &ec, size_t bytes_transferred) -> size_t {
+                                        if(timeout)
+                                            timeout->transferred(bytes_transferred);
+                                        return ec?0:static_cast<size_t>(std::min<unsigned long long>(remaining-bytes_transferred, 65536));
+                                    },
+                                    [this, socket, request, timeout]
                                     (const boost::system::error_code& ec, size_t /*bytes_transferred*/) {
-                                if(timer)
-                                    timer->cancel();
+                                if(timeout && !timeout->cancel())
+                                    return;
                                 if(!ec)
                                     find_resource(socket, request);
                             });
@@ -317,6 +829,20 @@ namespace SimpleWeb {
             });
         }
 
+        static void set_remote_endpoint(Request &request, const boost::asio::ip::tcp::endpoint &endpoint) {
+            request.remote_endpoint_address=endpoint.address().to_string();
+            request.remote_endpoint_port=endpoint.port();
+        }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        ///Clients of a Unix domain socket are usually unnamed, and are then all reported as "local"
+        static void set_remote_endpoint(Request &request, const boost::asio::local::stream_protocol::endpoint &endpoint) {
+            auto path=endpoint.path();
+            request.remote_endpoint_address=path.empty() || path[0]=='\0'?"local":path;
+            request.remote_endpoint_port=0;
+        }
+#endif
+
         bool parse_request(const std::shared_ptr<Request> &request) const {
             std::string line;
             getline(request->content, line);
@@ -359,37 +885,67 @@ namespace SimpleWeb {
         }
 
         void find_resource(const std::shared_ptr<socket_type> &socket, const std::shared_ptr<Request> &request) {
+            if(request->trace)
+                request->trace->content_read=std::chrono::steady_clock::now();
+            if(on_upgrade && on_upgrade(socket, request))
+                return;
             //Find path- and method-match, and call write_response
+            auto resource_function=match_resource(*request);
+            if(resource_function)
+                write_response(socket, request, *resource_function);
+        }
+
+        std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>, std::shared_ptr<typename ServerBase<socket_type>::Request>)>*
+        match_resource(Request &request) {
             for(auto& res: opt_resource) {
-                if(request->method==res.first) {
+                if(request.method==res.first) {
                     for(auto& res_path: res.second) {
                         REGEX_NS::smatch sm_res;
-                        if(REGEX_NS::regex_match(request->path, sm_res, res_path.first)) {
-                            request->path_match=std::move(sm_res);
-                            write_response(socket, request, res_path.second);
-                            return;
+                        if(REGEX_NS::regex_match(request.path, sm_res, res_path.regex)) {
+                            request.path_match=std::move(sm_res);
+                            request.resource_path=res_path.path;
+                            return &res_path.function;
                         }
                     }
                 }
             }
-            auto it_method=default_resource.find(request->method);
-            if(it_method!=default_resource.end()) {
-                write_response(socket, request, it_method->second);
-            }
+            auto it_method=default_resource.find(request.method);
+            if(it_method!=default_resource.end())
+                return &it_method->second;
+            return nullptr;
         }
         
         void write_response(const std::shared_ptr<socket_type> &socket, const std::shared_ptr<Request> &request, 
                 std::function<void(std::shared_ptr<typename ServerBase<socket_type>::Response>,
                                    std::shared_ptr<typename ServerBase<socket_type>::Request>)>& resource_function) {
             //Set timeout on the following boost::asio::async-read or write function
-            auto timer=get_timeout_timer(socket, timeout_content);
+            auto timeout=get_timeout(socket, timeout_content, nullptr);
+
+            if(request->trace)
+                request->trace->resource_found=std::chrono::steady_clock::now();
 
-            auto response=std::shared_ptr<Response>(new Response(socket), [this, request, timer](Response *response_ptr) {
+            auto response=std::shared_ptr<Response>(new Response(socket), [this, request, timeout](Response *response_ptr) {
+                auto now=std::chrono::steady_clock::now();
+                //How long a response is kept open says nothing about the load of the server. Its connection is counted
+                //again, before the socket held by the response can be released.
+                if(!response_ptr->kept_open)
+                    update_concurrency_limit(now-request->header_time);
+                else
+                    connections++;
+                if(request->trace)
+                    request->trace->response_released=now;
                 auto response=std::shared_ptr<Response>(response_ptr);
-                send(response, [this, response, request, timer](const boost::system::error_code& ec) {
-                    if(timer)
-                        timer->cancel();
-                    if(!ec) {
+                send(response, [this, response, request, timeout](const boost::system::error_code& ec) {
+                    if(timeout)
+                        timeout->cancel();
+                    if(request->trace) {
+                        request->trace->response_written=std::chrono::steady_clock::now();
+                        if(on_trace)
+                            on_trace(*request);
+                    }
+                    if(on_response)
+                        on_response(*request, response->status_code, response->bytes_sent, std::chrono::steady_clock::now()-request->header_time);
+                    if(!ec && !response->close_connection_after_response) {
                         float http_version;
                         try {
                             http_version=stof(request->http_version);
@@ -410,6 +966,7 @@ namespace SimpleWeb {
                     }
                 });
             });
+            response->timeout=timeout;
 
             try {
                 resource_function(response, request);
@@ -419,6 +976,8 @@ namespace SimpleWeb {
                     exception_handler(e);
                 return;
             }
+            if(request->trace)
+                request->trace->handler_returned=std::chrono::steady_clock::now();
         }
     };
     
@@ -434,15 +993,22 @@ namespace SimpleWeb {
                 ServerBase<HTTP>::ServerBase(port, num_threads, timeout_request, timeout_content) {}
         
     protected:
+        boost::asio::ip::tcp::endpoint listen_endpoint() {
+            if(config.address.size()>0)
+                return boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(config.address), config.port);
+            else
+                return boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), config.port);
+        }
+
         void accept() {
             //Create new socket for this connection
             //Shared_ptr is used to pass temporary objects to the asynchronous functions
-            auto socket=std::make_shared<HTTP>(*io_service);
+            auto socket=create_socket(*io_service);
                         
             acceptor->async_accept(*socket, [this, socket](const boost::system::error_code& ec){
-                //Immediately start accepting a new connection (if io_service hasn't been stopped)
+                //Immediately start accepting a new connection (if io_service hasn't been stopped and the limits allow it)
                 if (ec != boost::asio::error::operation_aborted)
-                    accept();
+                    accept_next();
                                 
                 if(!ec) {
                     boost::asio::ip::tcp::no_delay option(true);
@@ -453,5 +1019,47 @@ namespace SimpleWeb {
             });
         }
     };
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    typedef boost::asio::local::stream_protocol::socket UnixStream;
+
+    ///Server listening on a Unix domain socket, for instance behind a front proxy on the same host.
+    ///A leftover socket file at path is replaced when the server starts. If anything else is at path, start() throws
+    ///boost::system::system_error instead.
+    template<>
+    class Server<UnixStream> : public ServerBase<UnixStream> {
+    public:
+        Server(const std::string &path, size_t num_threads=1, long timeout_request=5, long timeout_content=300) :
+                ServerBase<UnixStream>::ServerBase(0, num_threads, timeout_request, timeout_content) {
+            config.address=path;
+        }
+
+    protected:
+        boost::asio::local::stream_protocol::endpoint listen_endpoint() {
+            if(!config.address.empty() && config.address[0]=='@')
+                return boost::asio::local::stream_protocol::endpoint(std::string(1, '\0')+config.address.substr(1));
+            struct stat path_stat;
+            if(::lstat(config.address.c_str(), &path_stat)==0) {
+                if(!S_ISSOCK(path_stat.st_mode))
+                    throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::file_exists),
+                                                      config.address+" exists and is not a socket");
+                ::unlink(config.address.c_str());
+            }
+            return boost::asio::local::stream_protocol::endpoint(config.address);
+        }
+
+        void accept() {
+            auto socket=create_socket(*io_service);
+
+            acceptor->async_accept(*socket, [this, socket](const boost::system::error_code& ec){
+                if (ec != boost::asio::error::operation_aborted)
+                    accept_next();
+
+                if(!ec)
+                    read_request_and_content(socket);
+            });
+        }
+    };
+#endif
 }
 #endif	/* SERVER_HTTP_HPP */
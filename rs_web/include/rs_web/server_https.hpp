@@ -0,0 +1,147 @@
+#ifndef SERVER_HTTPS_HPP
+#define	SERVER_HTTPS_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <boost/asio/ssl.hpp>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <vector>
+#include <string>
+
+namespace SimpleWeb {
+    typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> HTTPS;
+
+    ///HTTPS server. Sessions are kept in a cache shared by all connections and threads of the server, and can also be
+    ///resumed from session tickets, so that returning clients skip the full handshake.
+    ///The application protocol is negotiated through ALPN: to serve HTTP/2, attach an Http2<HTTPS> (http2_http.hpp)
+    ///and put "h2" in front of tls_config.alpn_protocols.
+    template<>
+    class Server<HTTPS> : public ServerBase<HTTPS> {
+    public:
+        class TlsConfig {
+            friend class Server<HTTPS>;
+
+            TlsConfig(): session_cache_size(20480), session_timeout(7200), session_tickets(true), alpn_protocols({"http/1.1"}) {}
+        public:
+            /// Sessions kept in the server's session cache. 0 disables the cache.
+            size_t session_cache_size;
+            /// Seconds a session can be resumed.
+            long session_timeout;
+            /// Issue session tickets, so that sessions can be resumed without a cache entry.
+            bool session_tickets;
+            /// Protocols offered through ALPN, most preferred first. Clients that do not use ALPN get HTTP/1.1.
+            std::vector<std::string> alpn_protocols;
+        };
+        /// Set before calling start().
+        TlsConfig tls_config;
+
+        Server(unsigned short port, size_t num_threads, const std::string &cert_file, const std::string &private_key_file,
+               long timeout_request=5, long timeout_content=300, const std::string &verify_file=std::string()) :
+                ServerBase<HTTPS>::ServerBase(port, num_threads, timeout_request, timeout_content),
+                context(boost::asio::ssl::context::tls_server) {
+            context.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+                                boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_tlsv1 |
+                                boost::asio::ssl::context::no_tlsv1_1);
+            context.use_certificate_chain_file(cert_file);
+            context.use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+
+            if(!verify_file.empty()) {
+                context.load_verify_file(verify_file);
+                context.set_verify_mode(boost::asio::ssl::verify_peer | boost::asio::ssl::verify_fail_if_no_peer_cert |
+                                        boost::asio::ssl::verify_client_once);
+            }
+        }
+
+        void start() {
+            auto ssl_context=context.native_handle();
+
+            //Sessions are only resumed by a server with the same session ID context, made from port:address
+            //reversed since it is truncated to SSL_MAX_SID_CTX_LENGTH
+            session_id_context=std::to_string(config.port)+':';
+            session_id_context.append(config.address.rbegin(), config.address.rend());
+            SSL_CTX_set_session_id_context(ssl_context, reinterpret_cast<const unsigned char*>(session_id_context.data()),
+                                           static_cast<unsigned>(std::min<size_t>(session_id_context.size(), SSL_MAX_SID_CTX_LENGTH)));
+
+            SSL_CTX_set_session_cache_mode(ssl_context, tls_config.session_cache_size>0?SSL_SESS_CACHE_SERVER:SSL_SESS_CACHE_OFF);
+            SSL_CTX_sess_set_cache_size(ssl_context, static_cast<long>(tls_config.session_cache_size));
+            SSL_CTX_set_timeout(ssl_context, tls_config.session_timeout);
+            if(tls_config.session_tickets)
+                SSL_CTX_clear_options(ssl_context, SSL_OP_NO_TICKET);
+            else
+                SSL_CTX_set_options(ssl_context, SSL_OP_NO_TICKET);
+            //One TLS 1.3 ticket per handshake is enough for a client to resume the session
+            SSL_CTX_set_num_tickets(ssl_context, 1);
+
+            alpn_protocols.clear();
+            for(auto &protocol: tls_config.alpn_protocols) {
+                alpn_protocols+=static_cast<char>(protocol.size());
+                alpn_protocols+=protocol;
+            }
+            SSL_CTX_set_alpn_select_cb(ssl_context, select_alpn_protocol, this);
+
+            ServerBase<HTTPS>::start();
+        }
+
+    protected:
+        boost::asio::ssl::context context;
+        std::string session_id_context;
+        ///tls_config.alpn_protocols in wire format
+        std::string alpn_protocols;
+
+        boost::asio::ip::tcp::endpoint listen_endpoint() {
+            if(config.address.size()>0)
+                return boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(config.address), config.port);
+            else
+                return boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), config.port);
+        }
+
+        void accept() {
+            //Create new socket for this connection
+            //Shared_ptr is used to pass temporary objects to the asynchronous functions
+            //OpenSSL drops the session of a connection freed without a TLS shutdown from the cache, so connections are
+            //marked as shut down before the counted socket is released. Only connections that completed the handshake
+            //qualify: a failed handshake or a fatal TLS error leaves the connection in init, and its session is dropped.
+            auto counted_socket=create_socket(*io_service, context);
+            auto socket=std::shared_ptr<HTTPS>(counted_socket.get(), [counted_socket](HTTPS *socket) {
+                if(SSL_is_init_finished(socket->native_handle()))
+                    SSL_set_shutdown(socket->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+            });
+
+            acceptor->async_accept(socket->lowest_layer(), [this, socket](const boost::system::error_code& ec){
+                //Immediately start accepting a new connection (if io_service hasn't been stopped and the limits allow it)
+                if (ec != boost::asio::error::operation_aborted)
+                    accept_next();
+
+                if(!ec) {
+                    boost::asio::ip::tcp::no_delay option(true);
+                    socket->lowest_layer().set_option(option);
+
+                    //The handshake has to complete within timeout_request, like the request header
+                    auto timeout=get_timeout(socket, timeout_request, nullptr);
+                    socket->async_handshake(boost::asio::ssl::stream_base::server, [this, socket, timeout](const boost::system::error_code& ec) {
+                        if(timeout && !timeout->cancel())
+                            return;
+                        if(!ec)
+                            read_request_and_content(socket);
+                    });
+                }
+            });
+        }
+
+        ///Picks the first of tls_config.alpn_protocols that the client offers; without a match, ALPN is not used
+        static int select_alpn_protocol(SSL* /*ssl*/, const unsigned char **out, unsigned char *out_length,
+                                        const unsigned char *in, unsigned int in_length, void *arg) {
+            auto &alpn_protocols=static_cast<Server<HTTPS>*>(arg)->alpn_protocols;
+            unsigned char *selected;
+            if(SSL_select_next_proto(&selected, out_length, reinterpret_cast<const unsigned char*>(alpn_protocols.data()),
+                                     static_cast<unsigned>(alpn_protocols.size()), in, in_length)!=OPENSSL_NPN_NEGOTIATED)
+                return SSL_TLSEXT_ERR_NOACK;
+            *out=selected;
+            return SSL_TLSEXT_ERR_OK;
+        }
+    };
+}
+
+#endif	/* SERVER_HTTPS_HPP */
@@ -0,0 +1,398 @@
+#ifndef THUMBNAIL_HTTP_HPP
+#define	THUMBNAIL_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+#include <rs_web/client_http.hpp>
+#include <rs_web/cache_http.hpp>
+
+#include <boost/asio.hpp>
+
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SimpleWeb {
+    ///8-bit image with 3 channels per pixel, rows stored without padding
+    class Frame {
+    public:
+        Frame(): width(0), height(0), bgr(false) {}
+        int width, height;
+        ///Channels are in blue, green, red order, as in OpenCV images, instead of red, green, blue
+        bool bgr;
+        std::vector<unsigned char> pixels;
+    };
+
+    ///libjpeg error manager that returns to the setjmp point instead of exiting the process
+    class JpegError {
+    public:
+        jpeg_error_mgr manager;
+        std::jmp_buf jump;
+
+        static void exit(j_common_ptr info) {
+            std::longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+        }
+    };
+
+    ///Source of the full size frames of scenes. load() is called from several worker threads at once.
+    class FrameStore {
+    public:
+        virtual ~FrameStore() {}
+        ///Returns false if there is no frame for scene
+        virtual bool load(const std::string &scene, Frame &frame)=0;
+    };
+
+    ///Frames stored as <directory>/<scene>.ppm (binary PPM) or <directory>/<scene>.jpg
+    class DirectoryFrameStore : public FrameStore {
+    public:
+        DirectoryFrameStore(const std::string &directory): directory(directory) {}
+
+        bool load(const std::string &scene, Frame &frame) {
+            std::ifstream ppm(directory+'/'+scene+".ppm", std::ios::binary);
+            if(ppm)
+                return read_ppm(ppm, frame);
+            std::ifstream jpeg(directory+'/'+scene+".jpg", std::ios::binary);
+            if(jpeg) {
+                std::ostringstream content;
+                content << jpeg.rdbuf();
+                return decode_jpeg(content.str(), frame);
+            }
+            return false;
+        }
+
+        ///Decodes a baseline or progressive JPEG to RGB
+        static bool decode_jpeg(const std::string &data, Frame &frame) {
+            jpeg_decompress_struct decompress;
+            JpegError error;
+            decompress.err=jpeg_std_error(&error.manager);
+            error.manager.error_exit=JpegError::exit;
+            if(setjmp(error.jump)) {
+                jpeg_destroy_decompress(&decompress);
+                return false;
+            }
+            jpeg_create_decompress(&decompress);
+            jpeg_mem_src(&decompress, reinterpret_cast<const unsigned char*>(data.data()), static_cast<unsigned long>(data.size()));
+            jpeg_read_header(&decompress, TRUE);
+            decompress.out_color_space=JCS_RGB;
+            jpeg_start_decompress(&decompress);
+            frame.width=static_cast<int>(decompress.output_width);
+            frame.height=static_cast<int>(decompress.output_height);
+            frame.bgr=false;
+            frame.pixels.resize(static_cast<size_t>(frame.width)*frame.height*3);
+            while(decompress.output_scanline<decompress.output_height) {
+                auto row=&frame.pixels[static_cast<size_t>(decompress.output_scanline)*frame.width*3];
+                jpeg_read_scanlines(&decompress, &row, 1);
+            }
+            jpeg_finish_decompress(&decompress);
+            jpeg_destroy_decompress(&decompress);
+            return true;
+        }
+
+    private:
+        std::string directory;
+
+        static bool read_ppm(std::istream &stream, Frame &frame) {
+            std::string magic;
+            int max_value=0;
+            stream >> magic >> frame.width >> frame.height >> max_value;
+            if(!stream || magic!="P6" || max_value!=255 || frame.width<=0 || frame.height<=0 || frame.width>65535 || frame.height>65535)
+                return false;
+            stream.get();
+            frame.bgr=false;
+            frame.pixels.resize(static_cast<size_t>(frame.width)*frame.height*3);
+            return static_cast<bool>(stream.read(reinterpret_cast<char*>(&frame.pixels[0]), static_cast<std::streamsize>(frame.pixels.size())));
+        }
+    };
+
+    ///Frames fetched from the object store app (html/app.py), which reads them from MongoDB:
+    ///GET <prefix><scene> returns the raw BGR pixels, with their size in X-Frame-Width and X-Frame-Height.
+    class HttpFrameStore : public FrameStore {
+    public:
+        HttpFrameStore(const std::string &host_port, const std::string &prefix="/scene_frame/", size_t timeout=10) :
+                host_port(host_port), prefix(prefix), timeout(timeout) {}
+
+        bool load(const std::string &scene, Frame &frame) {
+            //Clients are not shared between threads, and loads are rare enough for a connection each
+            Client<HTTP> client(host_port);
+            client.config.timeout=timeout;
+            std::shared_ptr<Client<HTTP>::Response> response;
+            try {
+                response=client.request("GET", prefix+scene);
+            }
+            catch(const std::exception &) {
+                return false;
+            }
+            if(response->status_code.compare(0, 3, "200")!=0)
+                return false;
+            auto width_it=response->header.find("X-Frame-Width");
+            auto height_it=response->header.find("X-Frame-Height");
+            if(width_it==response->header.end() || height_it==response->header.end())
+                return false;
+            try {
+                frame.width=std::stoi(width_it->second);
+                frame.height=std::stoi(height_it->second);
+            }
+            catch(const std::exception &) {
+                return false;
+            }
+            if(frame.width<=0 || frame.height<=0 || frame.width>65535 || frame.height>65535)
+                return false;
+            frame.bgr=true;
+            frame.pixels.resize(static_cast<size_t>(frame.width)*frame.height*3);
+            return static_cast<bool>(response->content.read(reinterpret_cast<char*>(&frame.pixels[0]), static_cast<std::streamsize>(frame.pixels.size())));
+        }
+
+    private:
+        std::string host_port, prefix;
+        size_t timeout;
+    };
+
+    ///Serves GET /thumb/<scene>?w=<width>: the frame of scene from a FrameStore, downscaled to width pixels with a box
+    ///filter and encoded as JPEG. Loading, scaling and encoding run on worker threads, and the encoded thumbnails are
+    ///kept in a byte-bounded LRU cache, so each size of a scene is only made once.
+    template<class socket_type>
+    class Thumbnailer {
+    public:
+        class Config {
+            friend class Thumbnailer<socket_type>;
+
+            Config(): default_width(422), max_width(1920), quality(80), max_age(86400) {}
+        public:
+            /// Width of thumbnails requested without w.
+            int default_width;
+            /// Larger requested widths are reduced to this. Frames are never enlarged.
+            int max_width;
+            /// JPEG quality, 1-100.
+            int quality;
+            /// Seconds clients and the cache may keep a thumbnail.
+            size_t max_age;
+        };
+        /// Set before calling attach().
+        Config config;
+
+        Thumbnailer(const ServerBase<socket_type> &server, FrameStore &store, size_t num_threads=2, size_t cache_bytes=32*1024*1024) :
+                store(store), cache(server, cache_bytes, 4), worker_work(new boost::asio::io_service::work(worker_io_service)) {
+            for(size_t c=0;c<num_threads;c++) {
+                threads.emplace_back([this] {
+                    worker_io_service.run();
+                });
+            }
+        }
+
+        ~Thumbnailer() {
+            worker_work.reset();
+            worker_io_service.stop();
+            for(auto &thread: threads)
+                thread.join();
+        }
+
+        ///Adds the /thumb/ resource to server. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.resource["^/thumb/([A-Za-z0-9_.-]+)(\\?.*)?$"]["GET"]=cache.wrap([this](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                                          std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                std::string scene=request->path_match[1];
+                auto width=requested_width(request->path_match[2]);
+                worker_io_service.post([this, response, scene, width] {
+                    std::string jpeg;
+                    if(!make(scene, width, jpeg)) {
+                        *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+                        return;
+                    }
+                    *response << "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: " << jpeg.size()
+                              << "\r\nCache-Control: public, max-age=" << config.max_age << "\r\n\r\n";
+                    response->write(jpeg.data(), static_cast<std::streamsize>(jpeg.size()));
+                });
+            }, config.max_age);
+        }
+
+        ///Makes the thumbnail of scene, width pixels wide or the width of the frame if that is smaller
+        bool make(const std::string &scene, int width, std::string &jpeg) {
+            Frame frame;
+            if(!store.load(scene, frame))
+                return false;
+            if(width<frame.width) {
+                Frame thumbnail;
+                thumbnail.width=width;
+                thumbnail.height=std::max(1, static_cast<int>(std::lround(static_cast<double>(frame.height)*width/frame.width)));
+                thumbnail.bgr=frame.bgr;
+                downscale(frame, thumbnail);
+                frame=std::move(thumbnail);
+            }
+            if(frame.bgr) {
+                for(size_t c=0;c<frame.pixels.size();c+=3)
+                    std::swap(frame.pixels[c], frame.pixels[c+2]);
+                frame.bgr=false;
+            }
+            return encode_jpeg(frame, config.quality, jpeg);
+        }
+
+        ///Resizes source to the size of target, which must not be larger, by averaging the source pixels that each
+        ///target pixel covers. Weights are 14-bit fixed point. The vertical pass, which reads every source pixel,
+        ///runs first and uses SSE2 where available.
+        static void downscale(const Frame &source, Frame &target) {
+            auto vertical=taps(source.height, target.height);
+            auto horizontal=taps(source.width, target.width);
+            size_t source_row=static_cast<size_t>(source.width)*3, target_row=static_cast<size_t>(target.width)*3;
+
+            //Vertical pass to 16-bit values with 7 fractional bits
+            std::vector<int16_t> rows(source_row*target.height);
+            std::vector<int32_t> sum(source_row);
+            for(int y=0;y<target.height;y++) {
+                std::fill(sum.begin(), sum.end(), 0);
+                auto weights=&vertical.weights[vertical.offset[y]];
+                int t=0;
+                for(;t+1<vertical.count[y];t+=2)
+                    add_rows(&source.pixels[(vertical.first[y]+t)*source_row], &source.pixels[(vertical.first[y]+t+1)*source_row],
+                             weights[t], weights[t+1], &sum[0], source_row);
+                if(t<vertical.count[y])
+                    add_rows(&source.pixels[(vertical.first[y]+t)*source_row], &source.pixels[(vertical.first[y]+t)*source_row],
+                             weights[t], 0, &sum[0], source_row);
+                auto row=&rows[y*source_row];
+                for(size_t x=0;x<source_row;x++)
+                    row[x]=static_cast<int16_t>((sum[x]+(1<<6))>>7);
+            }
+
+            //Horizontal pass back to 8 bits
+            target.pixels.resize(target_row*target.height);
+            for(int y=0;y<target.height;y++) {
+                auto row=&rows[y*source_row];
+                auto out=&target.pixels[y*target_row];
+                for(int x=0;x<target.width;x++) {
+                    auto weights=&horizontal.weights[horizontal.offset[x]];
+                    auto in=row+horizontal.first[x]*3;
+                    int32_t r=1<<20, g=1<<20, b=1<<20;
+                    for(int t=0;t<horizontal.count[x];t++) {
+                        r+=weights[t]*in[t*3];
+                        g+=weights[t]*in[t*3+1];
+                        b+=weights[t]*in[t*3+2];
+                    }
+                    out[x*3]=static_cast<unsigned char>(std::min(255, r>>21));
+                    out[x*3+1]=static_cast<unsigned char>(std::min(255, g>>21));
+                    out[x*3+2]=static_cast<unsigned char>(std::min(255, b>>21));
+                }
+            }
+        }
+
+        static bool encode_jpeg(const Frame &frame, int quality, std::string &jpeg) {
+            jpeg_compress_struct compress;
+            JpegError error;
+            compress.err=jpeg_std_error(&error.manager);
+            error.manager.error_exit=JpegError::exit;
+            unsigned char *buffer=nullptr;
+            unsigned long size=0;
+            if(setjmp(error.jump)) {
+                jpeg_destroy_compress(&compress);
+                std::free(buffer);
+                return false;
+            }
+            jpeg_create_compress(&compress);
+            jpeg_mem_dest(&compress, &buffer, &size);
+            compress.image_width=static_cast<JDIMENSION>(frame.width);
+            compress.image_height=static_cast<JDIMENSION>(frame.height);
+            compress.input_components=3;
+            compress.in_color_space=JCS_RGB;
+            jpeg_set_defaults(&compress);
+            jpeg_set_quality(&compress, quality, TRUE);
+            jpeg_start_compress(&compress, TRUE);
+            while(compress.next_scanline<compress.image_height) {
+                auto row=const_cast<unsigned char*>(&frame.pixels[static_cast<size_t>(compress.next_scanline)*frame.width*3]);
+                jpeg_write_scanlines(&compress, &row, 1);
+            }
+            jpeg_finish_compress(&compress);
+            jpeg_destroy_compress(&compress);
+            jpeg.assign(reinterpret_cast<char*>(buffer), size);
+            std::free(buffer);
+            return true;
+        }
+
+    private:
+        FrameStore &store;
+        ResponseCache<socket_type> cache;
+
+        boost::asio::io_service worker_io_service;
+        std::unique_ptr<boost::asio::io_service::work> worker_work;
+        std::vector<std::thread> threads;
+
+        ///Filter taps of each output sample: count weights from input sample first, summing to 1<<14
+        class Taps {
+        public:
+            std::vector<int> first, count, offset;
+            std::vector<int16_t> weights;
+        };
+
+        static Taps taps(int in_size, int out_size) {
+            Taps taps;
+            double scale=static_cast<double>(in_size)/out_size;
+            for(int o=0;o<out_size;o++) {
+                double begin=o*scale, end=std::min(static_cast<double>(in_size), (o+1)*scale);
+                int first=static_cast<int>(begin), last=std::min(in_size, static_cast<int>(std::ceil(end)));
+                taps.first.emplace_back(first);
+                taps.count.emplace_back(last-first);
+                taps.offset.emplace_back(static_cast<int>(taps.weights.size()));
+                int total=0, largest=static_cast<int>(taps.weights.size());
+                for(int i=first;i<last;i++) {
+                    double coverage=std::min(end, i+1.0)-std::max(begin, static_cast<double>(i));
+                    auto weight=static_cast<int16_t>(std::lround(coverage/scale*(1<<14)));
+                    if(i==first || weight>taps.weights[largest])
+                        largest=static_cast<int>(taps.weights.size());
+                    taps.weights.emplace_back(weight);
+                    total+=weight;
+                }
+                //Rounding errors go to the largest weight, so that flat areas keep their value
+                taps.weights[largest]=static_cast<int16_t>(taps.weights[largest]+(1<<14)-total);
+            }
+            return taps;
+        }
+
+        ///sum[x]+=a[x]*weight_a+b[x]*weight_b
+        static void add_rows(const unsigned char *a, const unsigned char *b, int16_t weight_a, int16_t weight_b, int32_t *sum, size_t size) {
+            size_t x=0;
+#ifdef __SSE2__
+            //Pixels of both rows are interleaved to 16-bit pairs, which _mm_madd_epi16 multiplies by the weight pair and adds
+            const __m128i zero=_mm_setzero_si128();
+            const __m128i weights=_mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(weight_b))<<16) |
+                                                                  static_cast<uint16_t>(weight_a)));
+            for(;x+16<=size;x+=16) {
+                __m128i a_bytes=_mm_loadu_si128(reinterpret_cast<const __m128i*>(a+x));
+                __m128i b_bytes=_mm_loadu_si128(reinterpret_cast<const __m128i*>(b+x));
+                __m128i a_low=_mm_unpacklo_epi8(a_bytes, zero), a_high=_mm_unpackhi_epi8(a_bytes, zero);
+                __m128i b_low=_mm_unpacklo_epi8(b_bytes, zero), b_high=_mm_unpackhi_epi8(b_bytes, zero);
+                __m128i *out=reinterpret_cast<__m128i*>(sum+x);
+                _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out), _mm_madd_epi16(_mm_unpacklo_epi16(a_low, b_low), weights)));
+                _mm_storeu_si128(out+1, _mm_add_epi32(_mm_loadu_si128(out+1), _mm_madd_epi16(_mm_unpackhi_epi16(a_low, b_low), weights)));
+                _mm_storeu_si128(out+2, _mm_add_epi32(_mm_loadu_si128(out+2), _mm_madd_epi16(_mm_unpacklo_epi16(a_high, b_high), weights)));
+                _mm_storeu_si128(out+3, _mm_add_epi32(_mm_loadu_si128(out+3), _mm_madd_epi16(_mm_unpackhi_epi16(a_high, b_high), weights)));
+            }
+#endif
+            for(;x<size;x++)
+                sum[x]+=a[x]*weight_a+b[x]*weight_b;
+        }
+
+        int requested_width(const std::string &query) const {
+            auto width=config.default_width;
+            auto position=query.find("w=");
+            if(position!=std::string::npos && (query[position-1]=='?' || query[position-1]=='&')) {
+                width=std::atoi(query.c_str()+position+2);
+                if(width<=0)
+                    width=config.default_width;
+            }
+            return std::min(width, config.max_width);
+        }
+    };
+}
+
+#endif	/* THUMBNAIL_HTTP_HPP */
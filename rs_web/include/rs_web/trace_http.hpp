@@ -0,0 +1,208 @@
+#ifndef TRACE_HTTP_HPP
+#define	TRACE_HTTP_HPP
+
+#include <rs_web/server_http.hpp>
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <cstdio>
+
+namespace SimpleWeb {
+    ///Records the processing phases of sampled requests, and serves them as Chrome trace JSON
+    ///(chrome://tracing, https://ui.perfetto.dev) through GET /debug/trace?seconds=N.
+    ///Requests are only sampled while a trace is being captured, so the tracer costs one atomic load per request otherwise.
+    template <class socket_type>
+    class Tracer {
+    public:
+        class Config {
+            friend class Tracer<socket_type>;
+
+            Config(): sample_every(1), max_spans_per_thread(100000), max_seconds(60), local_only(true) {}
+        public:
+            /// Trace every n-th request while capturing.
+            size_t sample_every;
+            /// Spans kept per thread during a capture; further spans are dropped.
+            size_t max_spans_per_thread;
+            /// Upper bound on the seconds parameter.
+            size_t max_seconds;
+            /// Answer /debug/trace only to clients on 127.0.0.1 or ::1, since a trace shows the requests of all clients.
+            bool local_only;
+        };
+
+        Config config;
+
+        Tracer(): active_captures(0), sample_counter(0), next_thread_id(0), epoch(std::chrono::steady_clock::now()) {}
+
+        ///Adds the hooks and the /debug/trace resource to server. Call before server.start().
+        void attach(ServerBase<socket_type> &server) {
+            server.trace_sampler=[this] {
+                if(active_captures.load(std::memory_order_relaxed)==0)
+                    return false;
+                return config.sample_every<=1 || sample_counter.fetch_add(1, std::memory_order_relaxed)%config.sample_every==0;
+            };
+            server.on_trace=[this](const typename ServerBase<socket_type>::Request &request) {
+                record(request);
+            };
+            server.resource["^/debug/trace(\\?.*)?$"]["GET"]=[this, &server](std::shared_ptr<typename ServerBase<socket_type>::Response> response,
+                                                                             std::shared_ptr<typename ServerBase<socket_type>::Request> request) {
+                if(config.local_only && request->remote_endpoint_address!="127.0.0.1" && request->remote_endpoint_address!="::1") {
+                    *response << "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+                    return;
+                }
+                capture(*server.io_service, response, seconds_parameter(request->path));
+            };
+        }
+
+    private:
+        class Span {
+        public:
+            const char *name;
+            int64_t start, duration;
+            std::shared_ptr<const std::string> path;
+        };
+
+        class ThreadBuffer {
+        public:
+            ThreadBuffer(size_t thread_id): thread_id(thread_id) {}
+            const size_t thread_id;
+            std::mutex mutex;
+            std::vector<Span> spans;
+        };
+
+        std::atomic<size_t> active_captures;
+        std::atomic<size_t> sample_counter;
+        std::atomic<size_t> next_thread_id;
+        const std::chrono::steady_clock::time_point epoch;
+
+        std::mutex buffers_mutex;
+        std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+
+        size_t seconds_parameter(const std::string &path) const {
+            size_t seconds=1;
+            auto position=path.find("seconds=");
+            if(position!=std::string::npos) {
+                try {
+                    seconds=std::stoul(path.substr(position+8));
+                }
+                catch(const std::exception &) {}
+            }
+            if(seconds==0)
+                seconds=1;
+            return std::min(seconds, config.max_seconds);
+        }
+
+        ThreadBuffer &thread_buffer() {
+            thread_local std::weak_ptr<ThreadBuffer> cached;
+            thread_local const Tracer *owner=nullptr;
+            auto buffer=cached.lock();
+            if(!buffer || owner!=this) {
+                buffer=std::make_shared<ThreadBuffer>(next_thread_id++);
+                std::lock_guard<std::mutex> lock(buffers_mutex);
+                buffers.emplace_back(buffer);
+                cached=buffer;
+                owner=this;
+            }
+            return *buffer;
+        }
+
+        int64_t microseconds(std::chrono::steady_clock::time_point time) const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time-epoch).count();
+        }
+
+        void record(const typename ServerBase<socket_type>::Request &request) {
+            auto &trace=*request.trace;
+            auto path=std::make_shared<const std::string>(request.method+' '+request.path);
+            const std::pair<const char*, std::pair<std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point> > phases[]={
+                {"request", {trace.header_read, trace.response_written}},
+                {"read_header", {trace.read_start, trace.header_read}},
+                {"parse_request", {trace.header_read, trace.parsed}},
+                {"read_content", {trace.parsed, trace.content_read}},
+                {"find_resource", {trace.content_read, trace.resource_found}},
+                {"handler", {trace.resource_found, trace.handler_returned}},
+                {"handler_async", {trace.handler_returned, trace.response_released}},
+                {"write_response", {trace.response_released, trace.response_written}}
+            };
+
+            auto &buffer=thread_buffer();
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            for(auto &phase: phases) {
+                //Phases that were skipped, for instance when a request has no content, leave their time points unset
+                if(phase.second.first==std::chrono::steady_clock::time_point() || phase.second.second==std::chrono::steady_clock::time_point())
+                    continue;
+                if(buffer.spans.size()>=config.max_spans_per_thread)
+                    return;
+                Span span;
+                span.name=phase.first;
+                span.start=microseconds(phase.second.first);
+                span.duration=microseconds(phase.second.second)-span.start;
+                span.path=path;
+                buffer.spans.emplace_back(std::move(span));
+            }
+        }
+
+        void capture(boost::asio::io_service &io_service, const std::shared_ptr<typename ServerBase<socket_type>::Response> &response, size_t seconds) {
+            auto start=microseconds(std::chrono::steady_clock::now());
+            active_captures++;
+            auto timer=std::make_shared<boost::asio::deadline_timer>(io_service);
+            timer->expires_from_now(boost::posix_time::seconds(static_cast<long>(seconds)));
+            timer->async_wait([this, timer, response, start](const boost::system::error_code &) {
+                auto json=collect(start, microseconds(std::chrono::steady_clock::now()));
+                *response << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " << json.size() << "\r\n\r\n" << json;
+            });
+        }
+
+        std::string collect(int64_t start, int64_t end) {
+            std::ostringstream json;
+            json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            bool first=true;
+            std::vector<std::shared_ptr<ThreadBuffer> > buffers_copy;
+            {
+                std::lock_guard<std::mutex> lock(buffers_mutex);
+                buffers_copy=buffers;
+            }
+            bool last_capture=--active_captures==0;
+            for(auto &buffer: buffers_copy) {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                json << (first?"":",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+                     << ",\"args\":{\"name\":\"server thread " << buffer->thread_id << "\"}}";
+                first=false;
+                for(auto &span: buffer->spans) {
+                    if(span.start<start || span.start>end)
+                        continue;
+                    json << ",{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                         << ",\"ts\":" << span.start << ",\"dur\":" << span.duration << ",\"args\":{\"request\":\"";
+                    escape(json, *span.path);
+                    json << "\"}}";
+                }
+                if(last_capture)
+                    buffer->spans.clear();
+            }
+            json << "]}";
+            return json.str();
+        }
+
+        static void escape(std::ostream &stream, const std::string &value) {
+            for(auto c: value) {
+                if(c=='"' || c=='\\')
+                    stream << '\\' << c;
+                else if(static_cast<unsigned char>(c)<0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    stream << escaped;
+                }
+                else
+                    stream << c;
+            }
+        }
+    };
+}
+
+#endif	/* TRACE_HTTP_HPP */
@@ -1,5 +1,20 @@
 #include <rs_web/server_http.hpp>
 #include <rs_web/client_http.hpp>
+#include <rs_web/proxy_http.hpp>
+#include <rs_web/cache_http.hpp>
+#include <rs_web/middleware_http.hpp>
+#include <rs_web/rate_limit_http.hpp>
+#include <rs_web/file_http.hpp>
+#include <rs_web/asset_http.hpp>
+#include <rs_web/access_log_http.hpp>
+#include <rs_web/trace_http.hpp>
+#include <rs_web/http2_http.hpp>
+#include <rs_web/thumbnail_http.hpp>
+#include <rs_web/event_http.hpp>
+#include <rs_web/pointcloud_http.hpp>
+#ifdef __cpp_impl_coroutine
+#include <rs_web/coroutine_http.hpp>
+#endif
 
 //Added for the json-example
 #define BOOST_SPIRIT_THREADSAFE
@@ -7,12 +22,15 @@
 #include <boost/property_tree/json_parser.hpp>
 
 //Added for the default_resource example
-#include <fstream>
 #include <boost/filesystem.hpp>
 #include <vector>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
+#include <ros/ros.h>
 #include <ros/package.h>
+#include <sensor_msgs/PointCloud2.h>
 
 using namespace std;
 //Added for the json-example:
@@ -22,22 +40,35 @@ typedef SimpleWeb::Server<SimpleWeb::HTTP> HttpServer;
 typedef SimpleWeb::Client<SimpleWeb::HTTP> HttpClient;
 
 //Added for the default_resource example
-void default_resource_send(const HttpServer &server, const shared_ptr<HttpServer::Response> &response,
-                           const shared_ptr<ifstream> &ifs)
+//Whether path, which must be canonical, is root_path or below it
+bool is_within(const string &path, const string &root_path)
+{
+  return path.compare(0, root_path.size(), root_path) == 0 && (path.size() == root_path.size() || path[root_path.size()] == '/');
+}
+
+void default_resource_send(const HttpServer &server, SimpleWeb::FileService &file_service, const shared_ptr<HttpServer::Response> &response,
+                           const shared_ptr<SimpleWeb::FileService::File> &file, const shared_ptr<vector<char>> &buffer, uint64_t offset)
 {
   //read and send 128 KB at a time
-  static vector<char> buffer(131072); // Safe when server is running on one thread
-  streamsize read_length;
-  if((read_length = ifs->read(&buffer[0], buffer.size()).gcount()) > 0)
+  file_service.async_read(file, offset, &(*buffer)[0], buffer->size(),
+                          [&server, &file_service, response, file, buffer, offset](const boost::system::error_code & ec, size_t read_length)
   {
-    response->write(&buffer[0], read_length);
-    if(read_length == static_cast<streamsize>(buffer.size()))
+    if(ec || read_length == 0)
     {
-      server.send(response, [&server, response, ifs](const boost::system::error_code & ec)
+      //The Content-Length can no longer be met, so the client learns of the error from the connection closing
+      cerr << "Could not read file: " << (ec ? ec.message() : "file was truncated") << endl;
+      response->close_connection_after_response = true;
+      return;
+    }
+    //The buffer is only refilled once it has been sent
+    response->write(boost::asio::buffer(*buffer, read_length), buffer);
+    if(offset + read_length < file->size())
+    {
+      server.send(response, [&server, &file_service, response, file, buffer, offset, read_length](const boost::system::error_code & ec)
       {
         if(!ec)
         {
-          default_resource_send(server, response, ifs);
+          default_resource_send(server, file_service, response, file, buffer, offset + read_length);
         }
         else
         {
@@ -45,19 +76,139 @@ void default_resource_send(const HttpServer &server, const shared_ptr<HttpServer
         }
       });
     }
+  });
+}
+
+void default_resource_open(const HttpServer &server, SimpleWeb::FileService &file_service, const shared_ptr<HttpServer::Response> &response,
+                           const shared_ptr<HttpServer::Request> &request, const boost::filesystem::path &root_path,
+                           const boost::filesystem::path &path, bool allow_directory)
+{
+  file_service.async_open(path.string(), [&server, &file_service, response, request, root_path, path, allow_directory](const boost::system::error_code & ec,
+                                                                                                                        shared_ptr<SimpleWeb::FileService::File> file)
+  {
+    string error;
+    if(ec)
+    {
+      error = ec == boost::system::errc::no_such_file_or_directory ? "file does not exist" : ec.message();
+    }
+    else if(!is_within(file->real_path(), root_path.string()))
+    {
+      //A symbolic link below the web root leads outside of it
+      error = "path must be within root path";
+    }
+    else if(file->is_directory())
+    {
+      if(allow_directory)
+      {
+        default_resource_open(server, file_service, response, request, root_path, path / "index.html", false);
+        return;
+      }
+      error = "file does not exist";
+    }
+
+    if(!error.empty())
+    {
+      string content = "Could not open path " + request->path + ": " + error;
+      *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << content.length() << "\r\n\r\n" << content;
+      return;
+    }
+
+    *response << "HTTP/1.1 200 OK\r\nContent-Length: " << file->size() << "\r\n\r\n";
+    if(file->size() > 0)
+    {
+      auto buffer = make_shared<vector<char>>(static_cast<size_t>(min<uint64_t>(file->size(), 131072)));
+      default_resource_send(server, file_service, response, file, buffer, 0);
+    }
+  });
+}
+
+//Copies the points of a cloud with float32 x, y and z fields, and the colors of its rgb or rgba field if it has one,
+//as in the clouds of PCL's PointXYZRGB(A) points that RoboSherlock publishes
+shared_ptr<SimpleWeb::PointCloud> to_point_cloud(const sensor_msgs::PointCloud2 &message)
+{
+  auto cloud = make_shared<SimpleWeb::PointCloud>();
+  cloud->frame_id = message.header.frame_id;
+  long offsets[3] = {-1, -1, -1};
+  long color_offset = -1;
+  for(auto &field : message.fields)
+  {
+    if(field.datatype == sensor_msgs::PointField::FLOAT32 && field.name.size() == 1 && field.name[0] >= 'x' && field.name[0] <= 'z')
+    {
+      offsets[field.name[0] - 'x'] = field.offset;
+    }
+    else if(field.name == "rgb" || field.name == "rgba")
+    {
+      color_offset = field.offset;
+    }
+  }
+  if(offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0 || message.is_bigendian ||
+     static_cast<size_t>(message.point_step) * message.width > message.row_step ||
+     static_cast<size_t>(message.row_step) * message.height > message.data.size())
+  {
+    return cloud;
+  }
+  for(auto offset : {offsets[0], offsets[1], offsets[2], color_offset})
+  {
+    if(offset + 4 > static_cast<long>(message.point_step))
+    {
+      return cloud;
+    }
+  }
+
+  size_t count = static_cast<size_t>(message.width) * message.height;
+  cloud->points.resize(count * 3);
+  if(color_offset >= 0)
+  {
+    cloud->colors.resize(count * 3);
   }
+  size_t i = 0;
+  for(size_t row = 0; row < message.height; row++)
+  {
+    for(size_t column = 0; column < message.width; column++, i++)
+    {
+      auto point = &message.data[row * message.row_step + column * message.point_step];
+      for(size_t c = 0; c < 3; c++)
+      {
+        memcpy(&cloud->points[i * 3 + c], point + offsets[c], sizeof(float));
+      }
+      if(color_offset >= 0)
+      {
+        //Packed as 0x00rrggbb, so blue comes first in little-endian order
+        cloud->colors[i * 3] = point[color_offset + 2];
+        cloud->colors[i * 3 + 1] = point[color_offset + 1];
+        cloud->colors[i * 3 + 2] = point[color_offset];
+      }
+    }
+  }
+  return cloud;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+  //Without a SIGINT handler of ROS, so that Ctrl-C still ends the server
+  ros::init(argc, argv, "http_server", ros::init_options::NoSigintHandler);
+
   //HTTP-server at port 8080 using 1 thread
   //Unless you do more heavy non-threaded processing in the resources,
   //1 thread is usually faster than several threads
   int portNr = 5555;
   HttpServer server(portNr, 1);
 
+  //Overload protection: stop accepting at 1024 connections besides those of event and cloud streams, and answer
+  //with 503 instead of queueing when 256 requests or 64 MB of request and response data are in flight
+  server.config.max_connections = 1024;
+  server.config.max_requests = 256;
+  server.config.max_buffered_bytes = 64 * 1024 * 1024;
+  //Clients trickling requests or reading responses at less than 1 KB/s do not keep their connection
+  server.config.min_transfer_rate = 1024;
+
   auto pkg_path = ros::package::getPath("rs_web");
 
+  //Files are opened and read by the FileService (io_uring or worker threads), so that slow storage
+  //does not block the reactor thread. It completes on the server's io_service, which is therefore created here.
+  server.io_service = make_shared<boost::asio::io_service>();
+  SimpleWeb::FileService file_service(*server.io_service);
+
   //Add resources using path-regex and method-string, and an anonymous function
   //POST-example for the path /string, responds the posted string
   server.resource["^/string$"]["POST"] = [](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
@@ -118,16 +269,22 @@ int main()
     *response <<  "HTTP/1.1 200 OK\r\nContent-Length: " << content_stream.tellp() << "\r\n\r\n" << content_stream.rdbuf();
   };
 
+  //Responses of GET resources that only depend on the path can be cached by wrapping the resource function
+  SimpleWeb::ResponseCache<SimpleWeb::HTTP> response_cache(server);
+
   //GET-example for the path /match/[number], responds with the matched string in path (number)
   //For instance a request GET /match/123 will receive: 123
-  server.resource["^/match/([0-9]+)$"]["GET"] = [&server](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+  server.resource["^/match/([0-9]+)$"]["GET"] = response_cache.wrap([](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
   {
     string number = request->path_match[1];
     *response << "HTTP/1.1 200 OK\r\nContent-Length: " << number.length() << "\r\n\r\n" << number;
-  };
+  }, 60);
+
+  //Heavy resources are limited to one request per second per client, with bursts of up to 4 requests
+  auto work_limit = SimpleWeb::make_middleware(SimpleWeb::RateLimit(1, 4));
 
   //Get example simulating heavy work in a separate thread
-  server.resource["^/work$"]["GET"] = [&server](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> /*request*/)
+  server.resource["^/work$"]["GET"] = work_limit.wrap([&server](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> /*request*/)
   {
     thread work_thread([response]
     {
@@ -136,57 +293,148 @@ int main()
       *response << "HTTP/1.1 200 OK\r\nContent-Length: " << message.length() << "\r\n\r\n" << message;
     });
     work_thread.detach();
-  };
+  });
+
+#ifdef __cpp_impl_coroutine
+  //Coroutine version of /work: the heavy part runs on a worker thread, and the reactor thread serves
+  //other requests in the meantime
+  SimpleWeb::WorkerPool worker_pool(2);
+  server.resource["^/work_coroutine$"]["GET"] = work_limit.wrap(SimpleWeb::coroutine_resource(server, [&server, &worker_pool](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> /*request*/) -> SimpleWeb::Task
+  {
+    string message = co_await SimpleWeb::offload(worker_pool, *server.io_service, []
+    {
+      this_thread::sleep_for(chrono::seconds(5));
+      return string("Work done");
+    });
+    *response << "HTTP/1.1 200 OK\r\nContent-Length: " << message.length() << "\r\n\r\n" << message;
+  }));
+#endif
+
+  //Object store: the Flask app from html/app.py is served through this server under /objstore,
+  //so that the dashboard does not need a second origin. Its POST /prolog_query requests are
+  //read-only queries, so identical ones are answered from the proxy cache.
+  SimpleWeb::ReverseProxy<SimpleWeb::HTTP> objstore_proxy(server, "localhost:5000");
+  objstore_proxy.config.cacheable_methods.insert("POST");
+  objstore_proxy.mount("/objstore");
+
+  //Scene thumbnails for the scene listing, made from the frames the object store app reads from MongoDB,
+  //or from the .ppm/.jpg files in $RS_WEB_FRAME_DIR if it is set
+  unique_ptr<SimpleWeb::FrameStore> frame_store;
+  if(auto frame_dir = getenv("RS_WEB_FRAME_DIR"))
+  {
+    frame_store = unique_ptr<SimpleWeb::FrameStore>(new SimpleWeb::DirectoryFrameStore(frame_dir));
+  }
+  else
+  {
+    frame_store = unique_ptr<SimpleWeb::FrameStore>(new SimpleWeb::HttpFrameStore("localhost:5000"));
+  }
+  SimpleWeb::Thumbnailer<SimpleWeb::HTTP> thumbnailer(server, *frame_store);
+  thumbnailer.attach(server);
 
   //Default GET-example. If no other matches, this anonymous function will be called.
   //Will respond with content in the web/-directory, and its subdirectories.
   //Default file: index.html
   //Can for instance be used to retrieve an HTML 5 client that uses REST-resources on this server
-  server.default_resource["GET"] = [&server,pkg_path](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+  auto web_root_path = boost::filesystem::canonical(pkg_path + "/html");
+
+  //Files of identical content, such as the copies of the ace editor in lib/ and static/ that rs_live.html and the
+  //object store pages load, are served once under an immutable /_a/<hash> URL that their paths redirect to, so that
+  //browsers download and cache them once. /_a/manifest.json lists these URLs.
+  SimpleWeb::AssetStore<SimpleWeb::HTTP> assets(web_root_path);
+  assets.attach(server);
+
+  server.default_resource["GET"] = [&server, &file_service, &assets, web_root_path](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
   {
-    try
+    //The path is checked lexically, since resolving it on the file system would block the reactor thread
+    auto request_path = boost::filesystem::path(request->path.substr(0, request->path.find('?')));
+    auto path = web_root_path;
+    string relative_path;
+    for(auto &element : request_path)
     {
-      auto web_root_path = boost::filesystem::canonical(pkg_path+"/html");
-      auto path = boost::filesystem::canonical(web_root_path / request->path);
-      //Check if path is within web_root_path
-      if(distance(web_root_path.begin(), web_root_path.end()) > distance(path.begin(), path.end()) ||
-         !equal(web_root_path.begin(), web_root_path.end(), path.begin()))
+      if(element == "..")
       {
-        throw invalid_argument("path must be within root path");
+        string content = "Could not open path " + request->path + ": path must be within root path";
+        *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << content.length() << "\r\n\r\n" << content;
+        return;
       }
-      if(boost::filesystem::is_directory(path))
+      if(element != "/" && element != ".")
       {
-        path /= "index.html";
+        path /= element;
+        relative_path += "/" + element.string();
       }
-      if(!(boost::filesystem::exists(path) && boost::filesystem::is_regular_file(path)))
-      {
-        throw invalid_argument("file does not exist");
-      }
-
-      auto ifs = make_shared<ifstream>();
-      ifs->open(path.string(), ifstream::in | ios::binary);
+    }
+    if(!assets.redirect(response, relative_path))
+    {
+      default_resource_open(server, file_service, response, request, web_root_path, path, true);
+    }
+  };
 
-      if(*ifs)
-      {
-        ifs->seekg(0, ios::end);
-        auto length = ifs->tellg();
+  //GET /debug/trace?seconds=N records the processing phases of the requests of the next N seconds
+  //and returns them as Chrome trace JSON, to clients on this machine only
+  SimpleWeb::Tracer<SimpleWeb::HTTP> tracer;
+  tracer.attach(server);
 
-        ifs->seekg(0, ios::beg);
+  //Requests that took more than a second from header to written response
+  SimpleWeb::RequestTimer<SimpleWeb::HTTP> request_timer([](const HttpServer::Request & request, chrono::steady_clock::duration duration)
+  {
+    if(duration > chrono::seconds(1))
+    {
+      cerr << "Slow request: " << request.method << " " << request.path << " took "
+           << chrono::duration_cast<chrono::milliseconds>(duration).count() << " ms" << endl;
+    }
+  });
+  request_timer.attach(server);
 
-        *response << "HTTP/1.1 200 OK\r\nContent-Length: " << length << "\r\n\r\n";
-        default_resource_send(server, response, ifs);
-      }
-      else
-      {
-        throw invalid_argument("could not read file");
-      }
+  //One-way updates for the dashboards, as Server-Sent Events on GET /events/<channel>. Pipeline status and
+  //annotator timing only matter in their latest state, so slow clients get the last event of each type.
+  //Processes on this machine publish with POST /events/<channel>?type=<event type>, with the data as content.
+  SimpleWeb::EventHub<SimpleWeb::HTTP> events(server);
+  events.add_channel("status", SimpleWeb::EventHub<SimpleWeb::HTTP>::Policy::coalesce);
+  events.add_channel("detections");
+  events.add_channel("timing", SimpleWeb::EventHub<SimpleWeb::HTTP>::Policy::coalesce);
+  events.attach(server);
+  server.resource["^/events/([A-Za-z0-9_.-]+)(\\?type=([A-Za-z0-9_.-]*))?$"]["POST"] = [&events](shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+  {
+    if(request->remote_endpoint_address != "127.0.0.1" && request->remote_endpoint_address != "::1")
+    {
+      *response << "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+      return;
     }
-    catch(const exception &e)
+    auto id = events.publish(request->path_match[1], request->path_match[3], request->content.string());
+    if(id == 0)
     {
-      string content = "Could not open path " + request->path + ": " + e.what();
-      *response << "HTTP/1.1 400 Bad Request\r\nContent-Length: " << content.length() << "\r\n\r\n" << content;
+      *response << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      return;
     }
+    string content = to_string(id);
+    *response << "HTTP/1.1 200 OK\r\nContent-Length: " << content.length() << "\r\n\r\n" << content;
+  };
+
+  //Point clouds for the 3D view of rs_live.html, on GET /clouds/points?lod=<level of detail>. The topic is
+  //subscribed to once, and each cloud is quantized into binary frames shared by all viewers, instead of being
+  //sent to each of them as JSON by rosbridge. Markers are still sent by rosbridge.
+  SimpleWeb::CloudStream<SimpleWeb::HTTP> clouds(server);
+  clouds.add_topic("points");
+  clouds.attach(server);
+  ros::NodeHandle node_handle;
+  //Clouds that arrive while one is being encoded are dropped, except for the latest
+  boost::function<void(const sensor_msgs::PointCloud2::ConstPtr &)> on_cloud = [&clouds](const sensor_msgs::PointCloud2::ConstPtr & message)
+  {
+    clouds.publish("points", to_point_cloud(*message));
   };
+  auto cloud_subscriber = node_handle.subscribe<sensor_msgs::PointCloud2>("/RoboSherlock/points", 1, on_cloud);
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  //One line per response, written in the background; relative to the node's working directory (ROS_HOME under roslaunch)
+  SimpleWeb::AccessLog access_log("rs_web_access.log");
+  access_log.attach(server);
+  access_log.start();
+
+  //HTTP/2 over cleartext connections, for clients connecting with prior knowledge or asking for Upgrade: h2c.
+  //Many requests then share one connection, and are answered in parallel.
+  SimpleWeb::Http2<SimpleWeb::HTTP> http2;
+  http2.attach(server);
 
   thread server_thread([&server]()
   {
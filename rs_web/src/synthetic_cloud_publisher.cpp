@@ -0,0 +1,142 @@
+//Publishes colored point clouds of a table with objects moving on it on /RoboSherlock/points, in place of
+//RoboSherlock, to try the 3D view of rs_live.html and the cloud stream of http_server without a robot.
+//Recorded clouds can be played instead with rosbag play.
+//
+//Parameters: ~rate (clouds per second, default 5), ~points (points per cloud, default 100000),
+//~frame_id (default my_frame, the fixed frame of the viewer)
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace std;
+
+//Laid out as PCL's PointXYZRGB, as RoboSherlock publishes it
+const uint32_t point_step = 32;
+const uint32_t rgb_offset = 16;
+
+void set_point(sensor_msgs::PointCloud2 &cloud, size_t index, float x, float y, float z, uint8_t r, uint8_t g, uint8_t b)
+{
+  auto point = &cloud.data[index * point_step];
+  float xyz[3] = {x, y, z};
+  memcpy(point, xyz, sizeof(xyz));
+  uint32_t rgb = (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+  memcpy(point + rgb_offset, &rgb, sizeof(rgb));
+}
+
+uint8_t shade(uint8_t value, float factor)
+{
+  return static_cast<uint8_t>(min(255.0f, value * factor));
+}
+
+//Samples the table top, a box and a cylinder turning around the table center by angle, and a sphere above them
+void make_scene(sensor_msgs::PointCloud2 &cloud, size_t count, double angle)
+{
+  const float table_height = 0.75f;
+  mt19937 random(42);
+  uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float turn_cos = static_cast<float>(cos(angle)), turn_sin = static_cast<float>(sin(angle));
+
+  for(size_t i = 0; i < count; i++)
+  {
+    float u = unit(random), v = unit(random), w = unit(random);
+    float noise = (unit(random) - 0.5f) * 0.002f;
+    auto part = i % 10;
+    if(part < 6)
+    {
+      //Table top, 1.2 m x 0.8 m
+      set_point(cloud, i, (u - 0.5f) * 1.2f, (v - 0.5f) * 0.8f, table_height + noise, shade(150, 0.9f + 0.2f * w), shade(110, 0.9f + 0.2f * w), 70);
+    }
+    else if(part < 8)
+    {
+      //Box of 0.2 m, on the side facing up or on one of the four sides
+      float x, y, z;
+      auto side = static_cast<int>(w * 5);
+      if(side == 0)
+      {
+        x = u - 0.5f;
+        y = v - 0.5f;
+        z = 0.5f;
+      }
+      else
+      {
+        x = (side & 1) ? (side < 3 ? 0.5f : -0.5f) : u - 0.5f;
+        y = (side & 1) ? u - 0.5f : (side < 3 ? 0.5f : -0.5f);
+        z = v - 0.5f;
+      }
+      float local_x = 0.3f + x * 0.2f, local_y = y * 0.2f;
+      set_point(cloud, i, turn_cos * local_x - turn_sin * local_y, turn_sin * local_x + turn_cos * local_y, table_height + 0.1f + z * 0.2f + noise,
+                200, shade(40, 1.0f + z), 40);
+    }
+    else if(part < 9)
+    {
+      //Cylinder of 0.05 m radius and 0.12 m height
+      float phi = u * 6.2831853f;
+      float local_x = -0.3f + 0.05f * cos(phi), local_y = 0.05f * sin(phi);
+      set_point(cloud, i, turn_cos * local_x - turn_sin * local_y, turn_sin * local_x + turn_cos * local_y, table_height + v * 0.12f + noise,
+                40, 90, shade(200, 0.7f + 0.3f * cos(phi)));
+    }
+    else
+    {
+      //Sphere of 0.08 m radius, bouncing in the middle
+      float phi = u * 6.2831853f, cos_theta = 2.0f * v - 1.0f, sin_theta = sqrt(1.0f - cos_theta * cos_theta);
+      float height = table_height + 0.3f + 0.1f * static_cast<float>(fabs(sin(2.0 * angle)));
+      set_point(cloud, i, 0.08f * sin_theta * cos(phi), 0.08f * sin_theta * sin(phi), height + 0.08f * cos_theta,
+                shade(60, 1.0f + 0.5f * cos_theta), 180, 60);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "synthetic_cloud_publisher");
+  ros::NodeHandle node_handle, private_node_handle("~");
+
+  double rate;
+  int points;
+  string frame_id;
+  private_node_handle.param("rate", rate, 5.0);
+  private_node_handle.param("points", points, 100000);
+  private_node_handle.param("frame_id", frame_id, string("my_frame"));
+
+  auto publisher = node_handle.advertise<sensor_msgs::PointCloud2>("/RoboSherlock/points", 1);
+
+  sensor_msgs::PointCloud2 cloud;
+  cloud.header.frame_id = frame_id;
+  cloud.height = 1;
+  cloud.width = static_cast<uint32_t>(max(points, 0));
+  const char *names[] = {"x", "y", "z", "rgb"};
+  const uint32_t offsets[] = {0, 4, 8, rgb_offset};
+  for(size_t i = 0; i < 4; i++)
+  {
+    sensor_msgs::PointField field;
+    field.name = names[i];
+    field.offset = offsets[i];
+    field.datatype = sensor_msgs::PointField::FLOAT32;
+    field.count = 1;
+    cloud.fields.push_back(field);
+  }
+  cloud.is_bigendian = false;
+  cloud.point_step = point_step;
+  cloud.row_step = point_step * cloud.width;
+  cloud.is_dense = true;
+  cloud.data.resize(cloud.row_step);
+
+  ROS_INFO("Publishing %u points %.1f times per second on /RoboSherlock/points", cloud.width, rate);
+  ros::Rate loop_rate(rate);
+  auto start = ros::Time::now();
+  while(ros::ok())
+  {
+    cloud.header.stamp = ros::Time::now();
+    make_scene(cloud, cloud.width, 0.5 * (cloud.header.stamp - start).toSec());
+    publisher.publish(cloud);
+    ros::spinOnce();
+    loop_rate.sleep();
+  }
+
+  return 0;
+}